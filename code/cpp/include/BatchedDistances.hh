@@ -0,0 +1,64 @@
+#ifndef BATCHED_DISTANCES_HH__
+#define BATCHED_DISTANCES_HH__
+
+#include "TimeSeries.hh"
+
+#include <vector>
+
+/**
+  Calculates the squared Euclidean distances of a batch of candidates,
+  all of which have the same length, to a set of time series. Distance
+  (i,j) refers to the i-th candidate and the j-th time series, and is
+  stored at index i * timeSeries.size() + j.
+
+  Instead of streaming every time series through the cache once per
+  candidate, all candidates are compared to a time series at the same
+  time. The distances of all windows are obtained by the decomposition
+
+    ||x - y||^2 = ||x||^2 - 2 <x,y> + ||y||^2,
+
+  where the dot products are calculated by a blocked kernel, similar to
+  a matrix multiplication, and the norms of the windows are obtained
+  from cumulative sums. Since this decomposition is subject to round-off
+  errors, all windows whose approximate distance is sufficiently close
+  to the minimum are checked again in the same way as in
+  `TimeSeries::distance()`. Hence, both functions yield the same results.
+*/
+
+void batchedDistances( const std::vector<const TimeSeries*>& candidates,
+                       const std::vector<TimeSeries>& timeSeries,
+                       std::vector<double>& distances );
+
+/**
+  Calculates the squared Euclidean distances of consecutive windows of a
+  time series, i.e. of the candidates of length n that start at `start`,
+  `start + 1`, and so on, to a set of time series. The distances are
+  stored in the same layout as for `batchedDistances()`.
+
+  The dot products of a candidate with all windows of a time series are
+  obtained from the ones of its predecessor by an update in constant time
+  per window, as in the STOMP algorithm for matrix profiles:
+
+    <x_{k+1}, y_{l+1}> = <x_k, y_l> - x[k] y[l] + x[k+n] y[l+n].
+
+  The approximations are refined in the same way as for batches, so the
+  results are again the same as the ones of `TimeSeries::distance()`.
+*/
+
+void slidingDistances( const TimeSeries& parent,
+                       std::size_t start,
+                       std::size_t n,
+                       std::size_t numCandidates,
+                       const std::vector<TimeSeries>& timeSeries,
+                       std::vector<double>& distances );
+
+/**
+  Checks whether `slidingDistances()` is expected to be faster than
+  `batchedDistances()` for candidates of length n. The updates take the
+  same time for every length, whereas the dot products of a batch grow
+  with the length of its candidates.
+*/
+
+bool slidingDistancesCheaper( std::size_t n ) noexcept;
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef COMPACT_STORAGE_HH__
+#define COMPACT_STORAGE_HH__
+
+#include "SlidingWindow.hh"
+#include "TimeSeries.hh"
+
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+  Precisions in which the values of time series may be stored for the
+  calculation of distances.
+*/
+
+enum class Precision
+{
+  Double,
+  Float,
+  Int16
+};
+
+/**
+  Parses a precision, i.e. one of "double", "float", or "int16". Throws
+  an exception for any other name.
+*/
+
+Precision parsePrecision( const std::string& name );
+
+/** Returns the name of a precision, as accepted by `parsePrecision()` */
+std::string name( Precision precision );
+
+/**
+  @class CompactStorage
+  @brief Copy of a set of time series in a narrower data type
+
+  Stores the values of all time series contiguously as 32-bit floats or
+  as 16-bit integers, which are scaled by a common factor. The squared
+  Euclidean distances of candidates, which are identified by the index
+  of their time series, their start, and their length, are calculated
+  by the same kernels as for double precision: every time series is
+  converted once per comparison, which is exact, into a buffer that
+  remains in the cache while the kernel passes over it. Only the stored
+  values are read from memory.
+
+  For 16-bit integers, the scale is the largest power of ten that
+  represents every value exactly, provided that one exists. Otherwise,
+  the values are scaled to the full range, which rounds them. Missing
+  values are stored as the smallest integer, which is outside of this
+  range, and they are restored as NaNs for the kernels.
+
+  The distances differ from the ones for double precision by at most
+  `tolerance()`, which accounts for the rounding of the stored values and
+  for the round-off errors of both calculations. Values that are integers
+  of at most 16 bits are stored exactly in both formats; values with one
+  or two decimals are stored exactly by 16-bit integers as long as they
+  are sufficiently small.
+
+  The storage is a copy: the values in double precision are still needed
+  for reporting shapelets. Hence, it reduces the memory bandwidth of the
+  distance calculations, but not the memory that is required for the
+  values themselves. Only the squared sums of a `Dataset`, which are not
+  used with compact storage, may be omitted.
+*/
+
+class CompactStorage
+{
+public:
+
+  /**
+    Stores a set of time series in the given precision, which must not
+    be `Precision::Double`. Throws an exception for infinite values if
+    they cannot be represented.
+  */
+
+  CompactStorage( const std::vector<TimeSeries>& timeSeries, Precision precision );
+
+  Precision precision() const noexcept { return _precision; }
+
+  /** Returns the value of one unit of the stored integers, or one */
+  double scale() const noexcept { return _scale; }
+
+  /** Returns the maximum absolute error of a stored value */
+  double error() const noexcept { return _error; }
+
+  /** Returns the number of bytes required for all values */
+  std::size_t bytes() const noexcept;
+
+  /**
+    Calculates the squared Euclidean distances between a candidate and
+    all time series, storing the j-th one at `distances[j]`. The values
+    of the candidate are taken from the storage.
+  */
+
+  void distances( const CandidateView& candidate, double* distances ) const;
+
+  /**
+    Returns an upper bound for the absolute difference between the
+    distance of a candidate of length n to any time series and the same
+    distance in double precision.
+  */
+
+  double tolerance( std::size_t n ) const noexcept;
+
+private:
+
+  /**
+    Converts the stored values in [begin, end) to double precision. For
+    16-bit integers, they remain unscaled.
+  */
+
+  void widen( std::size_t begin, std::size_t end, std::vector<double>& values ) const;
+
+  Precision _precision;
+
+  double _scale    = 1.0; // value of one unit of the stored integers
+  double _error    = 0.0; // maximum error of a stored value
+  double _maxValue = 0.0; // maximum absolute value of all time series
+
+  // Time series i occupies [_offsets[i], _offsets[i+1]) of the values
+  std::vector<std::size_t> _offsets;
+
+  std::vector<float> _floats;
+  std::vector<std::int16_t> _integers;
+};
+
+#endif
@@ -6,8 +6,6 @@
 #include <iosfwd>
 #include <ostream>
 
-#include <boost/math/distributions/chi_squared.hpp>
-
 /**
   @class ContingencyTable
   @brief Models a (partially) filled contingency table
@@ -34,9 +32,21 @@ public:
     The flag `withPseudocounts` changes the behaviour of the class. If set, the
     table will be created such that no cell can have a value of zero. This will
     ensure that the $p$-value is always valid.
+
+    The lookup table provides the minimum attainable $p$-values and has
+    to match the marginals of the table, including pseudocounts. It is
+    *not* copied, so it must outlive the table.
   */
 
-  ContingencyTable( unsigned n, unsigned n1, double threshold, bool withPseudocounts );
+  ContingencyTable( unsigned n, unsigned n1, double threshold, bool withPseudocounts, const LookupTable& lookupTable );
+
+  /**
+    Creates a complete contingency table from its cells. This is useful
+    for restoring a table that has been stored. Pseudocounts, if any,
+    are assumed to be part of the cells.
+  */
+
+  ContingencyTable( unsigned as, unsigned bs, unsigned cs, unsigned ds, double threshold, const LookupTable& lookupTable );
 
   /**
     Updates the contingency table by inserting a new element with
@@ -67,6 +77,9 @@ public:
     Calculates the $p$-value of a filled contingency table. This
     function does not work if the table is only partially filled
     or its values do not add up to the number of instances.
+
+    The $p$-values of complete tables are cached by the lookup table,
+    so every distinct table is only evaluated once.
   */
 
   long double p() const;
@@ -88,6 +101,15 @@ public:
 
   long double min_optimistic_p() const;
 
+  /**
+    Calculates the smallest minimum attainable $p$-value of all tables
+    that can be obtained by completing an incomplete table. If it is
+    larger than Tarone's threshold, the table can never become testable,
+    regardless of the remaining elements.
+  */
+
+  long double min_reachable_p() const;
+
   // Attributes --------------------------------------------------------
 
   unsigned as() const noexcept { return _as; }
@@ -113,12 +135,17 @@ private:
 
   long double t() const;
 
-  static boost::math::chi_squared_distribution<long double> _chi2;
-  static LookupTable _lookupTable;
+  /** Calculates the $p$-value of the table without using the cache */
+  long double calculateP() const;
+
+  /**
+    Minimum attainable $p$-values for the marginals of the table. This
+    also provides the total number of items and the number of items of
+    class 1 (both fixed), so they do not have to be stored in every
+    table.
+  */
 
-  unsigned _n;  //< Total number of items (fixed)
-  unsigned _n1; //< Total number of items with class 1 (fixed)
-  unsigned _n0; //< Total number of items with class 0 (fixed)
+  const LookupTable* _lookupTable;
 
   // Entries in the actual contingency table. We follow common
   // terminology here, so that the table looks like this:
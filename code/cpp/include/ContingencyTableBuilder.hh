@@ -0,0 +1,71 @@
+#ifndef CONTINGENCY_TABLE_BUILDER_HH__
+#define CONTINGENCY_TABLE_BUILDER_HH__
+
+#include "ContingencyTable.hh"
+#include "LookupTable.hh"
+
+#include <utility>
+#include <vector>
+
+/*
+ @class ContingencyTableBuilder
+ @brief Creates the contingency tables of a candidate pattern at once
+
+ In contrast to `ContingencyTables`, which updates all tables whenever
+ a new distance is added, this class collects all distances, sorts them,
+ and sweeps over them once, counting the labels. This yields the tables
+ of all thresholds in O(n log n) time.
+
+ The builder does not store any state, so a single instance may be used
+ by multiple threads. Buffers are provided by the client, which permits
+ reusing them for multiple candidates.
+*/
+
+class ContingencyTableBuilder
+{
+public:
+
+  // Short-hand for a pair of a distance value and its corresponding
+  // label. This is only defined for convenience purposes.
+  using DistanceLabelPair = std::pair<double, bool>;
+
+  /**
+    Creates a new builder for the given marginals. The lookup table is
+    shared by all tables and must outlive them.
+  */
+
+  ContingencyTableBuilder( unsigned n, unsigned n1, bool withPseudocounts, const LookupTable& lookupTable );
+
+  /**
+    Creates one contingency table for every distinct distance and stores
+    them in increasing order of their threshold. The distances will be
+    sorted in place. Optionally, the threshold from Tarone's criterion
+    can be added as an additional parameter. If this is non-zero, it will
+    be used to skip all tables that are not testable.
+
+    Missing distances, i.e. NaNs, are larger than every threshold, so
+    their items are counted on the far side of every table, but they do
+    not create a table of their own.
+
+    The tables obtained with pruning are the same as the ones obtained by
+    `ContingencyTables`. The function returns the number of tables that
+    have been pruned.
+  */
+
+  std::size_t operator()( std::vector<DistanceLabelPair>& distanceLabelPairs,
+                          std::vector<ContingencyTable>& tables,
+                          long double p_tarone = 0.0 ) const;
+
+private:
+  unsigned _n;
+  unsigned _n1;
+
+  // Stores whether we want to use pseudocounts in each contingency
+  // table created by this class.
+  bool _withPseudocounts;
+
+  // Minimum attainable $p$-values for all tables created by this class
+  const LookupTable& _lookupTable;
+};
+
+#endif
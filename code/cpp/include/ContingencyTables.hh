@@ -19,8 +19,12 @@ class ContingencyTables
 {
 public:
 
-  /** Creates a new set of contingency tables, which is initially empty */
-  ContingencyTables( unsigned n, unsigned n1, bool withPseudocounts );
+  /**
+    Creates a new set of contingency tables, which is initially empty.
+    The lookup table is shared by all tables and must outlive them.
+  */
+
+  ContingencyTables( unsigned n, unsigned n1, bool withPseudocounts, const LookupTable& lookupTable );
 
   /**
     Updates all contingency tables by adding a new element with a given
@@ -28,6 +32,12 @@ public:
     of each contingency table correctly. Optionally, the threshold from
     Tarone's criterion can be added as an additional parameter. If this
     is non-zero, it will be used to perform pruning.
+
+    Pruning only removes tables that cannot become testable, regardless
+    of the remaining elements. Hence, the remaining tables do not depend
+    on the order of the elements, and pruning with a threshold yields
+    the tables of pruning with a larger one, minus those whose minimum
+    attainable $p$-value exceeds the threshold.
   */
 
   void insert( double distance, bool label, long double p_tarone = 0.0 );
@@ -56,15 +66,21 @@ public:
   std::pair<long double, ContingencyTable> min() const noexcept;
 
   /**
-    Removes all those tables whose optimistic $p$-values is larger than
-    the given threshold. Typically, $p$ is Tarone's adjusted threshold,
-    so one essentially removes patterns that cannot become testable.
+    Removes all those tables that cannot become testable any more, i.e.
+    whose minimum reachable $p$-value is larger than the given threshold.
+    Typically, $p$ is Tarone's adjusted threshold.
 
     The function returns the number of tables that have been pruned.
   */
 
   std::size_t prune( long double p );
 
+  /** @returns Number of tables that have been pruned so far */
+  std::size_t numPruned() const noexcept
+  {
+    return _numPruned;
+  }
+
   // Returns the number of tables that are left after performing
   // a pruning process. Ideally, this should only be *one* table
   // but edge cases in data might lead to different results.
@@ -87,10 +103,17 @@ private:
   // table managed by this class.
   bool _withPseudocounts;
 
+  // Minimum attainable $p$-values for all tables managed by this class
+  const LookupTable& _lookupTable;
+
   // All contingency tables stored by the manager. This container is
   // reduced by the pruning operation.
   std::vector<ContingencyTable> _tables;
 
+  // Number of tables that have been pruned, either during insertion
+  // or explicitly.
+  std::size_t _numPruned = 0;
+
   // Short-hand for a pair of a distance value and its corresponding
   // label. This is only defined for convenience purposes.
   using DistanceLabelPair = std::pair<double, bool>;
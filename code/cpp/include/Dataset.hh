@@ -0,0 +1,78 @@
+#ifndef DATASET_HH__
+#define DATASET_HH__
+
+#include "TimeSeries.hh"
+
+#include <memory>
+#include <vector>
+
+#include <cstddef>
+
+/**
+  @class Dataset
+  @brief Contiguous storage of a set of time series
+
+  Stores the values of all time series in a single buffer, in which the
+  values of every time series start at a multiple of `alignment` bytes,
+  optionally followed by the cumulative sums of their squares, which are
+  only used by the distances in double precision. The time series of
+  the dataset are views of this buffer, so they can be passed to every
+  function that expects time series, and all distance calculations read
+  their values from the buffer.
+
+  Optionally, the buffer is backed by huge pages, which reduces the
+  number of TLB misses for large datasets. This is only a hint for the
+  operating system and has no effect on platforms other than Linux.
+*/
+
+class Dataset
+{
+public:
+
+  using ValueType = typename TimeSeries::ValueType;
+
+  /** Alignment of the values of every time series in bytes */
+  static constexpr std::size_t alignment = 64;
+
+  /**
+    Copies the values of a set of time series into a new dataset. The
+    index and the start of every time series are kept. Without squared
+    sums, the buffer only requires half of the memory.
+  */
+
+  explicit Dataset( const std::vector<TimeSeries>& timeSeries, bool hugePages = false, bool squaredSums = true );
+
+  // The time series are views of the buffer, so copying a dataset would
+  // require adjusting all of them. Moving it keeps the buffer, though.
+  Dataset( const Dataset& )            = delete;
+  Dataset& operator=( const Dataset& ) = delete;
+
+  Dataset( Dataset&& )            = default;
+  Dataset& operator=( Dataset&& ) = default;
+
+  /** Returns views of all time series of the dataset */
+  const std::vector<TimeSeries>& timeSeries() const noexcept { return _timeSeries; }
+
+  const TimeSeries& operator[]( std::size_t i ) const noexcept { return _timeSeries[i]; }
+
+  std::size_t size() const noexcept { return _timeSeries.size(); }
+
+  /** Returns the number of bytes of the buffer, including its padding */
+  std::size_t bytes() const noexcept { return _bytes; }
+
+  /**
+    Checks whether the buffer may be backed by huge pages, i.e. whether
+    they have been requested and the operating system accepted the hint.
+  */
+
+  bool hugePages() const noexcept { return _hugePages; }
+
+private:
+  std::unique_ptr<char[]> _memory;
+  std::size_t _bytes = 0;
+  bool _hugePages    = false;
+
+  std::vector<TimeSeries> _timeSeries;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef FFT_HH__
+#define FFT_HH__
+
+#include <complex>
+#include <vector>
+
+#include <cstddef>
+
+/**
+  Calculates the discrete Fourier transform of a sequence of complex
+  values in-place, using an iterative radix-2 Cooley--Tukey scheme. The
+  length of the sequence must be a power of two. If requested, the
+  inverse transform is calculated instead; it includes the scaling by
+  the reciprocal length.
+*/
+
+void fft( std::vector< std::complex<double> >& values, bool inverse = false );
+
+/**
+  Returns the size of the transform that is used by the sliding dot
+  product calculation for a sequence of length m, i.e. the smallest
+  power of two that is not smaller than m.
+*/
+
+std::size_t transformSize( std::size_t m ) noexcept;
+
+/**
+  Calculates the sliding dot products of a pattern of length n with all
+  windows of a sequence of length m, i.e. the dot product of the pattern
+  with the window that starts at every offset of the sequence. The m-n+1
+  dot products are stored in `result`. The workspace is used to prevent
+  repeated allocations when calling the function multiple times.
+
+  Both sequences are transformed simultaneously by a single transform,
+  using the real and the imaginary part of the input, respectively. The
+  dot products are subject to the usual round-off errors of the FFT.
+*/
+
+void slidingDotProducts( const double* pattern, std::size_t n,
+                         const double* sequence, std::size_t m,
+                         std::vector< std::complex<double> >& workspace,
+                         std::vector<double>& result );
+
+#endif
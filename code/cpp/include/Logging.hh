@@ -0,0 +1,12 @@
+#ifndef LOGGING_HH__
+#define LOGGING_HH__
+
+/**
+  Sets up the log of an executable such that all messages are written
+  to `std::clog`, prefixed with a time stamp and coloured according to
+  their severity.
+*/
+
+void setupLogging();
+
+#endif
@@ -1,16 +1,47 @@
 #ifndef LOOKUP_TABLE_HH__
 #define LOOKUP_TABLE_HH__
 
+#include <atomic>
+#include <memory>
+#include <string>
 #include <vector>
 
-#include <boost/math/distributions/chi_squared.hpp>
+#include <cassert>
+
+/**
+  Statistical tests for contingency tables. Pearson's chi-squared test
+  is the default; Fisher's exact test is better suited for small sets of
+  time series, for which the approximation of the chi-squared test is
+  not reliable.
+*/
+
+enum class Test
+{
+  ChiSquared,
+  Fisher
+};
+
+/**
+  Parses a test, i.e. one of "chi2" or "fisher". Throws an exception for
+  any other name.
+*/
+
+Test parseTest( const std::string& name );
+
+/** Returns the name of a test, as accepted by `parseTest()` */
+std::string name( Test test );
 
 class LookupTable
 {
 public:
 
-  /** Creates a new lookup table for the given marginals */
-  LookupTable( unsigned n, unsigned n1 );
+  /** Creates a new lookup table for the given marginals and test */
+  LookupTable( unsigned n, unsigned n1, Test test = Test::ChiSquared );
+
+  ~LookupTable();
+
+  LookupTable( const LookupTable& )            = delete;
+  LookupTable& operator=( const LookupTable& ) = delete;
 
   /**
      Returns the minimum attainable $p$-value of a given marginal
@@ -22,20 +53,123 @@ public:
     return _values[rs];
   }
 
+  /**
+    Returns the smallest minimum attainable $p$-value of all marginal
+    values in the closed range [rsMin, rsMax].
+  */
+
+  long double min( unsigned rsMin, unsigned rsMax ) const noexcept;
+
+  /**
+    Returns the $p$-value of a complete contingency table with the given
+    number of items of class 1 in the left column, `as`, and the given
+    marginal value. Since the other marginals are fixed, they determine
+    the table. The value is calculated by the function upon its first
+    request and cached afterwards; this may be called by any thread.
+
+    Threads do not block each other: if multiple threads request a new
+    value at the same time, all of them calculate it, but only the first
+    one stores it. The function thus has to be deterministic.
+  */
+
+  template <class Function> long double p( unsigned as, unsigned rs, Function calculate ) const
+  {
+    assert( as <= _n1 );
+    assert( rs <= _n  );
+
+    auto&& entry = this->entry( as, rs );
+
+    if( entry.state.load( std::memory_order_acquire ) == Entry::Ready )
+      return entry.value;
+
+    auto value         = calculate();
+    auto expectedState = Entry::Empty;
+
+    if( entry.state.compare_exchange_strong( expectedState, Entry::Busy, std::memory_order_acquire ) )
+    {
+      entry.value = value;
+      entry.state.store( Entry::Ready, std::memory_order_release );
+    }
+
+    return value;
+  }
+
+  /**
+    Calculates the two-sided $p$-value of Fisher's exact test for a
+    table with the given cells, whose total has to be at most n. This
+    sums the hypergeometric probabilities of all tables with the same
+    marginals that are at most as probable as the given one, starting
+    from both tails, and is thus linear in the number of these tables.
+  */
+
+  long double fisher( unsigned as, unsigned bs, unsigned cs, unsigned ds ) const noexcept;
+
   // Attributes --------------------------------------------------------
 
   unsigned n()  const noexcept { return _n;  }
   unsigned n1() const noexcept { return _n1; }
 
+  Test test() const noexcept { return _test; }
+
 private:
+
+  /**
+    Cached $p$-value of a complete table. Its value may only be read once
+    its state is `Ready`, and it may only be written by the thread that
+    changed the state from `Empty` to `Busy`.
+  */
+
+  struct Entry
+  {
+    enum State : unsigned char { Empty, Busy, Ready };
+
+    Entry() noexcept : state( Empty ), value( 0.0 ) {}
+
+    std::atomic<State> state;
+    long double value;
+  };
+
+  /** Calculates the minimum attainable $p$-values of the chi-squared test */
+  void setupChiSquared();
+
+  /**
+    Returns the cache entry of a complete table, allocating the row of
+    all entries with the same value of as upon its first request.
+  */
+
+  Entry& entry( unsigned as, unsigned rs ) const;
+
   unsigned _n  = 0;
   unsigned _n1 = 0;
 
-  /** Shared distribution for calculating $p$-values */
-  static boost::math::chi_squared_distribution<long double> _chi2;
+  Test _test   = Test::ChiSquared;
+
+  /**
+    Natural logarithms of the factorials 0!, ..., n!, which are only
+    required for Fisher's exact test.
+  */
+
+  std::vector<long double> _logFactorials;
 
   /** Maps marginals to $p$-values */
   std::vector<long double> _values;
+
+  /**
+    Marginals that are local minima of the $p$-values. The function has
+    only a few of them, so the minimum over a range of marginals is
+    attained either at its boundaries or at one of these positions.
+  */
+
+  std::vector<unsigned> _minima;
+
+  /**
+    Cached $p$-values of complete tables, indexed by as and rs. There is
+    one row of n+1 entries for every value of as, but only few of them
+    are usually required, so rows are only allocated on demand. They are
+    owned by the lookup table.
+  */
+
+  std::unique_ptr< std::atomic<Entry*>[] > _rows;
 };
 
 #endif
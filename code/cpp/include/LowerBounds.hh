@@ -0,0 +1,83 @@
+#ifndef LOWER_BOUNDS_HH__
+#define LOWER_BOUNDS_HH__
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+  Norms of the differences between a pattern and a window, in the form
+  in which the distance functors accumulate them, i.e. without taking
+  any roots:
+
+    - `SquaredEuclidean`: sum of (x-y)^2
+    - `Manhattan`:        sum of |x-y|
+    - `Power`:            sum of |x-y|^p, for p > 1
+    - `Chebyshev`:        max of |x-y|
+*/
+
+enum class Norm
+{
+  SquaredEuclidean,
+  Manhattan,
+  Power,
+  Chebyshev
+};
+
+/**
+  Counts how many offsets were examined by the cascade of lower bounds,
+  and at which stage they were rejected. Offsets that pass all stages
+  are evaluated in full.
+*/
+
+struct LowerBoundStatistics
+{
+  std::uint64_t numOffsets   = 0;
+  std::uint64_t numKim       = 0; // rejected by the first and last values
+  std::uint64_t numPAA       = 0; // rejected by piecewise aggregate means
+  std::uint64_t numAbandoned = 0; // abandoned in the order of deviations
+
+  LowerBoundStatistics& operator+=( const LowerBoundStatistics& other ) noexcept
+  {
+    numOffsets   += other.numOffsets;
+    numKim       += other.numKim;
+    numPAA       += other.numPAA;
+    numAbandoned += other.numAbandoned;
+
+    return *this;
+  }
+};
+
+/**
+  Returns the statistics that have been accumulated by the calling thread
+  since the last call, and resets them. Every thread keeps its own counts,
+  so clients such as an extraction collect them from their own threads
+  and remain independent of each other.
+*/
+
+LowerBoundStatistics takeLowerBoundStatistics() noexcept;
+
+/**
+  Calculates the minimum distance of a pattern of length n to all
+  windows of a sequence of length m, with n <= m, following the cascade
+  of the UCR suite:
+
+    1. A constant-time bound from the first and the last value of every
+       window (LB_Kim).
+    2. A bound from the means of a few segments of the pattern and of
+       the window (PAA), which are obtained from cumulative sums.
+    3. Early abandoning, where the values are visited in descending
+       order of their deviation from the mean of the pattern, because
+       they are likely to contribute the most.
+
+  Every window that survives the cascade is evaluated once more in its
+  natural order, and the bounds are compared with a margin that covers
+  their round-off errors. The result is thus the same as the one of the
+  plain scan over all offsets with early abandoning.
+*/
+
+double cascadeDistance( const double* pattern, std::size_t n,
+                        const double* sequence, std::size_t m,
+                        Norm norm,
+                        double p = 2.0 );
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef OUTPUT_HH__
+#define OUTPUT_HH__
+
+#include "SignificantShapelets.hh"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/**
+  @struct Parameters
+  @brief Settings of an extraction
+
+  Stores all settings of an extraction that are either reported along
+  with its results, or required in order to merge the shards of an
+  extraction such that the results are the same.
+*/
+
+struct Parameters
+{
+  unsigned minLength = 0;
+  unsigned maxLength = 0;
+  unsigned stride    = 1;
+  unsigned keep      = 0; // maximum number of shapelets to report (0 = unlimited)
+
+  bool allShapelets     = false;
+  bool disablePruning   = false;
+  bool mergeTables      = false;
+  bool removeDuplicates = false;
+  bool standardize      = false;
+  bool withPseudocounts = false;
+
+  // Parameters of the standardization. They are required in order to
+  // undo the standardization of all reported shapelets.
+  double mu    = 0.0;
+  double sigma = 1.0;
+
+  // Name of the distance functor; remains empty for the default
+  // distance.
+  std::string distance;
+
+  // Tolerances for the removal of duplicate candidates
+  double rtol = 1e-6;
+  double atol = 1e-8;
+
+  // Statistical test of the contingency tables
+  std::string test = "chi2";
+
+  // Precision in which the time series were stored for the distance
+  // calculations
+  std::string precision = "double";
+
+  // Version of S3M that performed the extraction
+  std::string version;
+};
+
+/**
+  Writes the results of an extraction to an output stream. JSON is used
+  to format the output. If the parameters specify a maximum number of
+  shapelets, only the most significant ones will be written.
+
+  The values of the shapelets are obtained from the time series that
+  were used for the extraction. If they have been standardized, the
+  standardization is undone for the output.
+*/
+
+void writeJSON( std::ostream& out,
+                const Parameters& parameters,
+                long double p_tarone,
+                const std::vector<SignificantShapelets::SignificantShapelet>& shapelets,
+                const std::vector<TimeSeries>& timeSeries );
+
+/**
+  Writes the header of a shard file, which contains the settings of the
+  extraction in a human-readable format. The evaluations of the shard
+  follow afterwards.
+*/
+
+void writeShardHeader( std::ostream& out, const Parameters& parameters, unsigned shard, unsigned numShards );
+
+/**
+  Reads the header of a shard file and leaves the stream at the start of
+  the evaluations of the shard. Throws if the header is invalid.
+*/
+
+void readShardHeader( std::istream& in, Parameters& parameters, unsigned& shard, unsigned& numShards );
+
+#endif
@@ -1,7 +1,10 @@
 #ifndef SIGNIFICANT_SHAPELETS_HH__
 #define SIGNIFICANT_SHAPELETS_HH__
 
+#include "CompactStorage.hh"
 #include "ContingencyTable.hh"
+#include "LookupTable.hh"
+#include "SlidingWindow.hh"
 #include "TimeSeries.hh"
 
 #include "distances/DistanceFunctor.hh"
@@ -28,12 +31,23 @@ public:
 
   using ValueType = typename TimeSeries::ValueType;
 
-  /** Data structure for describing the result of the extraction process */
+  /**
+    Data structure for describing the result of the extraction process.
+    Since there may be a very large number of results, the values of the
+    shapelet are not stored; they are only obtained from the time series
+    when required.
+  */
+
   struct SignificantShapelet
   {
-    TimeSeries shapelet;    // the extracted shapelet
+    unsigned index;         // index of the time series containing the shapelet
+    unsigned start;         // start of the shapelet in its time series
+    unsigned length;        // length of the shapelet
     long double p;          // $p$-value
-    ContingencyTable table; // best contingency table
+    ContingencyTable table; // best contingency table (minimum attainable $p$-values are only available during the extraction)
+
+    /** Returns the values of the shapelet from the given time series */
+    TimeSeries shapelet( const std::vector<TimeSeries>& timeSeries ) const;
   };
 
   // Constructors ------------------------------------------------------
@@ -62,6 +76,29 @@ public:
     _distance = distance;
   }
 
+  /**
+    Sets the precision in which the time series are stored for the
+    default distance. Narrower types reduce the memory bandwidth of the
+    distance calculations, but change the distances slightly unless all
+    values are represented exactly; see `CompactStorage`.
+  */
+
+  void setPrecision( Precision precision ) noexcept
+  {
+    _precision = precision;
+  }
+
+  /**
+    Sets the statistical test of the contingency tables. The minimum
+    attainable $p$-values for Tarone's method are derived from the same
+    test.
+  */
+
+  void setTest( Test test ) noexcept
+  {
+    _test = test;
+  }
+
   void disablePruning( bool value = true ) noexcept
   {
     _disablePruning = value;
@@ -82,6 +119,17 @@ public:
     _removeDuplicates = value;
   }
 
+  /**
+    Sets the relative and the absolute tolerance below which candidates
+    are considered to be duplicates; see `SlidingWindow::setTolerances()`.
+  */
+
+  void setDuplicateTolerances( double rtol, double atol ) noexcept
+  {
+    _rtol = rtol;
+    _atol = atol;
+  }
+
   void reportAllShapelets( bool value = true ) noexcept
   {
     _reportAllShapelets = value;
@@ -97,6 +145,31 @@ public:
     _withPseudocounts = value;
   }
 
+  /**
+    Sets the number of threads for evaluating candidates. Using more
+    than one thread does not change the results of the extraction.
+  */
+
+  void setNumThreads( unsigned numThreads ) noexcept
+  {
+    _numThreads = numThreads;
+  }
+
+  /**
+    Compares batches of candidates of the same length to every time
+    series at the same time, instead of comparing one candidate after
+    the other. This improves the cache efficiency for large data sets,
+    but it does not change the results of the extraction.
+
+    Batches are only used for a single candidate length; for multiple
+    lengths, evaluating prefix families is considerably faster.
+  */
+
+  void batchCandidates( bool value = true ) noexcept
+  {
+    _batchCandidates = value;
+  }
+
   // Extraction --------------------------------------------------------
 
   /**
@@ -109,8 +182,146 @@ public:
                                                long double& tarone,
                                                std::vector<long double>& thresholds );
 
+  // Sharding ----------------------------------------------------------
+  //
+  // An extraction may be split into multiple *shards*, each of which is
+  // evaluating a deterministic subset of all candidates. The results of
+  // all shards can be merged afterwards. This yields exactly the same
+  // results as a single extraction with the same settings.
+
+  /**
+    Evaluates every candidate whose index is congruent to the index of
+    the shard modulo the number of shards. The evaluations are written
+    to the given stream in a compact binary format.
+  */
+
+  void operator()( const std::vector<TimeSeries>& timeSeries,
+                   const std::vector<bool>& labels,
+                   unsigned shard,
+                   unsigned numShards,
+                   std::ostream& out );
+
+  /**
+    Merges the evaluations of all shards of an extraction, as written by
+    the function above, and reports the significant shapelets. This has
+    to use the same settings as the extraction of the shards.
+
+    Since the shards only contain the candidates, the time series are
+    restored from them. Values that do not belong to any reported
+    candidate are set to NaN.
+  */
+
+  std::vector<SignificantShapelet> merge( const std::vector<std::istream*>& shards,
+                                          long double& tarone,
+                                          std::vector<long double>& thresholds,
+                                          std::vector<TimeSeries>& timeSeries );
+
 private:
 
+  struct Evaluation;
+  struct Reduction;
+
+  /** Calculates the initial thresholds of Tarone's method */
+  void setup( Reduction& reduction ) const;
+
+  /**
+    Enumerates all candidates of a set of time series. They are views
+    of the time series, whose values are only copied when required.
+  */
+
+  Candidates candidates( const std::vector<TimeSeries>& timeSeries ) const;
+
+  /**
+    Stores the time series in the requested precision if it is not the
+    default one. This only applies to the default distance.
+  */
+
+  void setupStorage( const std::vector<TimeSeries>& timeSeries );
+
+  /** Calculates the distance between a candidate and a time series */
+  ValueType distance( const TimeSeries& candidate, const TimeSeries& T ) const;
+
+  /**
+    Calculates the distances between a candidate and all time series,
+    storing the j-th one at `distances[j]`. The distance functor is only
+    selected once for all of them.
+  */
+
+  void distances( const TimeSeries& candidate,
+                  const std::vector<TimeSeries>& timeSeries,
+                  ValueType* distances ) const;
+
+  /**
+    Evaluates a single candidate, using the current threshold for the
+    pruning of contingency tables. This function may be called by any
+    worker, so it does not modify the reduction.
+  */
+
+  void evaluate( const CandidateView& candidate,
+                 const std::vector<TimeSeries>& timeSeries,
+                 const std::vector<bool>& labels,
+                 const Reduction& reduction,
+                 Evaluation& evaluation ) const;
+
+  /**
+    Groups the candidates into *prefix families*, i.e. candidates that
+    share their time series and their start, and thus only differ in
+    their length. Families are sorted by time series and start, while
+    their candidates are sorted by length.
+  */
+
+  std::vector< std::vector<std::size_t> > families( const Candidates& candidates ) const;
+
+  /**
+    Groups consecutive candidates that share their time series and their
+    length into batches of a fixed maximum size.
+  */
+
+  std::vector< std::vector<std::size_t> > batches( const Candidates& candidates ) const;
+
+  /**
+    Evaluates a group of candidates at once, i.e. either a batch or a
+    prefix family, depending on `isBatch`. For a prefix family, the
+    distances are calculated incrementally over all of its lengths. In
+    both cases, the distances are the same as the ones of evaluating
+    every candidate on its own.
+  */
+
+  void evaluate( const Candidates& candidates,
+                 const std::vector<std::size_t>& group,
+                 bool isBatch,
+                 const std::vector<TimeSeries>& timeSeries,
+                 const std::vector<bool>& labels,
+                 const Reduction& reduction,
+                 std::vector<Evaluation>& evaluations ) const;
+
+  /**
+    Checks whether Tarone's threshold has used up all of its levels, in
+    which case no pattern is testable and candidates need not be
+    evaluated any more.
+  */
+
+  bool exhausted( const Reduction& reduction ) const noexcept;
+
+  /**
+    Merges the evaluation of a single candidate into the list of
+    significant shapelets and adjusts Tarone's threshold. Candidates
+    may be reduced in any order; the final threshold and the testable
+    shapelets do not depend on it, only their order does.
+  */
+
+  void reduce( const CandidateView& candidate,
+               const Evaluation& evaluation,
+               Reduction& reduction ) const;
+
+  /**
+    Calculates the actual $p$-values of all testable shapelets and
+    reports the significant ones. The time series are required in order
+    to detect shapelets with equal values.
+  */
+
+  std::vector<SignificantShapelet> finalize( Reduction& reduction, const std::vector<TimeSeries>& timeSeries ) const;
+
   /**
     Distance functor that will be used to calculate distance between
     a shapelet and a time series. Will only be used when initialized
@@ -119,6 +330,13 @@ private:
 
   std::shared_ptr<DistanceFunctor> _distance = nullptr;
 
+  /**
+    Compact copy of the time series of the current extraction, which is
+    used for the default distance unless the precision is double.
+  */
+
+  std::shared_ptr<CompactStorage> _storage = nullptr;
+
   /**
     Calculates the minimum attainable $p$-values for a given problem
     size. This is required in order to perform the adjustment of the
@@ -128,7 +346,7 @@ private:
     is required to access elements from the back of the vector.
   */
 
-  static std::vector<long double> min_attainable_p_values( unsigned n, unsigned n1, bool withPseudocounts );
+  static std::vector<long double> min_attainable_p_values( unsigned n, unsigned n1, bool withPseudocounts, const LookupTable& lookupTable );
 
   unsigned _minWindowSize;
   unsigned _maxWindowSize;
@@ -138,19 +356,25 @@ private:
   bool _mergeTables          = false;
   bool _quiet                = false;
   bool _removeDuplicates     = false;
+  double _rtol               = 1e-6;
+  double _atol               = 1e-8;
   bool _reportAllShapelets   = false;
   bool _withPseudocounts     = false;
+  bool _batchCandidates      = false;
+  unsigned _numThreads       = 1;
+
+  // Maximum number of candidates in a batch
+  std::size_t _batchSize     = 32;
+
+  // Precision of the values for the default distance
+  Precision _precision       = Precision::Double;
+
+  // Statistical test of the contingency tables
+  Test _test                 = Test::ChiSquared;
 
   // Target FWER before any adjustments of the threshold are being made
   // using Tarone's method.
   double _alpha = 0.01;
 };
 
-/**
-  Adds a significant shapelet to an output stream. JSON is used to
-  format the output.
-*/
-
-std::ostream& operator<<( std::ostream& o, const SignificantShapelets::SignificantShapelet& ss );
-
 #endif
@@ -1,12 +1,128 @@
 #ifndef SLIDING_WINDOW_HH__
 #define SLIDING_WINDOW_HH__
 
+#include <iterator>
 #include <vector>
 
+#include <cstddef>
+
 // A forward declaration is sufficient here because we are only
-// *declaring* a function below.
+// *declaring* functions below.
 class TimeSeries;
 
+/**
+  View of a candidate shapelet, i.e. of a window of one of the time
+  series. It does not contain any values; they are obtained from the
+  time series whenever they are required.
+*/
+
+struct CandidateView
+{
+  unsigned index  = 0; // index of the time series containing the window
+  unsigned start  = 0; // start of the window in its time series
+  unsigned length = 0; // length of the window
+};
+
+/**
+  Sequence of the candidates of a set of time series, ordered by their
+  time series, their length, and their start. Unless duplicates have
+  been removed, the candidates are not stored; every candidate is
+  calculated on demand from the lengths of the time series, so the
+  memory requirements only depend on the number of time series and the
+  number of window sizes.
+*/
+
+class Candidates
+{
+public:
+
+  /**
+    Random-access iterator over all candidates, which yields them by
+    value because they are only created upon access.
+  */
+
+  class const_iterator
+  {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type        = CandidateView;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const CandidateView*;
+    using reference         = CandidateView;
+
+    const_iterator() = default;
+
+    const_iterator( const Candidates* candidates, std::size_t index )
+      : _candidates( candidates )
+      , _index( index )
+    {
+    }
+
+    CandidateView operator*() const noexcept { return ( *_candidates )[ _index ]; }
+
+    const_iterator& operator++() noexcept { ++_index; return *this; }
+    const_iterator& operator--() noexcept { --_index; return *this; }
+
+    const_iterator  operator++( int ) noexcept { auto it = *this; ++_index; return it; }
+    const_iterator  operator--( int ) noexcept { auto it = *this; --_index; return it; }
+
+    const_iterator& operator+=( std::ptrdiff_t n ) noexcept { _index = std::size_t( std::ptrdiff_t( _index ) + n ); return *this; }
+    const_iterator& operator-=( std::ptrdiff_t n ) noexcept { _index = std::size_t( std::ptrdiff_t( _index ) - n ); return *this; }
+
+    const_iterator operator+( std::ptrdiff_t n ) const noexcept { auto it = *this; return it += n; }
+    const_iterator operator-( std::ptrdiff_t n ) const noexcept { auto it = *this; return it -= n; }
+
+    std::ptrdiff_t operator-( const const_iterator& other ) const noexcept { return std::ptrdiff_t( _index ) - std::ptrdiff_t( other._index ); }
+
+    CandidateView operator[]( std::ptrdiff_t n ) const noexcept { return *( *this + n ); }
+
+    bool operator==( const const_iterator& other ) const noexcept { return _index == other._index; }
+    bool operator!=( const const_iterator& other ) const noexcept { return _index != other._index; }
+    bool operator< ( const const_iterator& other ) const noexcept { return _index <  other._index; }
+    bool operator> ( const const_iterator& other ) const noexcept { return _index >  other._index; }
+    bool operator<=( const const_iterator& other ) const noexcept { return _index <= other._index; }
+    bool operator>=( const const_iterator& other ) const noexcept { return _index >= other._index; }
+
+  private:
+    const Candidates* _candidates = nullptr;
+    std::size_t _index            = 0;
+  };
+
+  /** Returns the number of candidates */
+  std::size_t size() const noexcept;
+
+  /** Checks whether there are no candidates at all */
+  bool empty() const noexcept { return this->size() == 0; }
+
+  /**
+    Returns the candidate with the given index. This requires a binary
+    search over the blocks of candidates of the same time series and the
+    same length.
+  */
+
+  CandidateView operator[]( std::size_t index ) const noexcept;
+
+  const_iterator begin() const noexcept { return const_iterator( this, 0 );            }
+  const_iterator end()   const noexcept { return const_iterator( this, this->size() ); }
+
+private:
+  friend class SlidingWindow;
+
+  unsigned _minSize    = 0; // smallest window size
+  unsigned _numLengths = 0; // number of window sizes
+  unsigned _stride     = 1; // stride
+
+  // Index of the first candidate of every block of windows with the same
+  // time series and the same length; the last entry is the total number
+  // of candidates.
+  std::vector<std::size_t> _offsets = { 0 };
+
+  // Explicit list of candidates, which is only used once duplicates have
+  // been removed
+  std::vector<CandidateView> _views;
+  bool _explicit = false;
+};
+
 /*
   Class for extracting candidate shapelets by going over them using
   a sliding window approach. The class offers various configuration
@@ -40,15 +156,35 @@ public:
   void setRemoveDuplicates( bool value = true );
   bool removeDuplicates() const noexcept;
 
+  /**
+    Sets the relative and the absolute tolerance for duplicate removal.
+    As for `TimeSeries::isClose()`, two windows are considered to be
+    duplicates if every pair of values satisfies |x - y| <= atol + rtol * |y|.
+  */
+
+  void setTolerances( double rtol, double atol );
+
+  double rtol() const noexcept { return _rtol; }
+  double atol() const noexcept { return _atol; }
+
   // Extraction --------------------------------------------------------
 
   /**
     Main extraction routine. Uses the current settings of the sliding
-    window extractor to go over a time series. Candidate patterns are
-    stored and will be returned in the order in which they appear.
+    window extractor to go over a set of time series. The candidates are
+    views of the time series, which are ordered by their time series,
+    their length, and their start.
+
+    Without duplicate removal, this only counts the windows of every
+    time series. Otherwise, the windows of every time series are first
+    reduced to the ones that are not *close* to any previous remaining
+    window of the same time series. Of those, a window is only kept if
+    it is not close to any candidate that has been kept before. Both
+    checks use a hash index of the remaining windows, so a window is
+    only compared to windows with similar values.
   */
 
-  std::vector<TimeSeries> operator()( const TimeSeries& T ) const noexcept;
+  Candidates operator()( const std::vector<TimeSeries>& timeSeries ) const;
 
 private:
   unsigned _minSize      = 0;     // minimum window size
@@ -56,6 +192,9 @@ private:
   unsigned _stride       = 1;     // stride
 
   bool _removeDuplicates = false; // flag indicating whether duplicates should be removed
+
+  double _rtol           = 1e-6;  // relative tolerance for duplicates
+  double _atol           = 1e-8;  // absolute tolerance for duplicates
 };
 
 #endif
@@ -0,0 +1,83 @@
+#ifndef SQUARED_EUCLIDEAN_DISTANCE_HH__
+#define SQUARED_EUCLIDEAN_DISTANCE_HH__
+
+#include <string>
+
+#include <cstddef>
+
+/**
+  Instruction sets for which vectorized kernels of the distances
+  exist. They are ordered by their width, so any
+  set that compares less than the one of the current CPU may be used
+  as well.
+*/
+
+enum class InstructionSet
+{
+  Scalar,
+  SSE2,
+  AVX2,
+  AVX512
+};
+
+/**
+  Determines the widest instruction set that is supported by the CPU
+  (and by the operating system) at runtime. The result is cached.
+*/
+
+InstructionSet detectInstructionSet() noexcept;
+
+/** Returns a human-readable name of an instruction set */
+std::string name( InstructionSet instructionSet );
+
+/**
+  Calculates the minimum squared Euclidean distance of a pattern of
+  length n to all windows of a sequence of length m, with n <= m.
+
+  The vectorized kernels evaluate multiple *offsets* at once, so every
+  window is still summed in its natural order. Early abandoning is
+  checked once per block of values instead of after every value. The
+  result is thus exactly the same as the one of the scalar kernel.
+*/
+
+double squaredEuclideanDistance( const double* pattern, std::size_t n,
+                                 const double* sequence, std::size_t m,
+                                 InstructionSet instructionSet = detectInstructionSet() ) noexcept;
+
+/** Largest integer power for which a specialized kernel exists */
+constexpr unsigned maxIntegerPower = 8;
+
+/**
+  Calculates the minimum Minkowski distance, without taking the root, of
+  a pattern of length n to all windows of a sequence of length m, with
+  n <= m, for an integer power p <= `maxIntegerPower`. This is the sum of
+  the p-th powers of the absolute differences, or their maximum for p = 0,
+  which denotes the maximum norm. Powers are calculated by repeated
+  multiplication, and the kernels are vectorized in the same way as the
+  one of the squared Euclidean distance, which is used for p = 2.
+*/
+
+double minkowskiDistance( const double* pattern, std::size_t n,
+                          const double* sequence, std::size_t m,
+                          unsigned p,
+                          InstructionSet instructionSet = detectInstructionSet() ) noexcept;
+
+/**
+  Calculates the minimum squared Euclidean distances of all prefixes of
+  a pattern whose lengths are in [minLength, maxLength] to all windows
+  of a sequence of length m, with 1 <= minLength <= maxLength <= m. The
+  distance of the prefix of length minLength + k is stored in the k-th
+  entry of `distances`.
+
+  Every window sum is extended from one length to the next, instead of
+  being recalculated for every prefix, and windows are abandoned once
+  they exceed the distance of the longest prefix. The results are the
+  same as the ones of `squaredEuclideanDistance()` for every prefix.
+*/
+
+void squaredEuclideanDistances( const double* pattern, std::size_t minLength, std::size_t maxLength,
+                                const double* sequence, std::size_t m,
+                                double* distances,
+                                InstructionSet instructionSet = detectInstructionSet() ) noexcept;
+
+#endif
@@ -11,6 +11,11 @@
 
   Represents a time series, i.e. a sequence of values of some length,
   for which this class provides lookup and loading functions.
+
+  A time series either owns its values or it is a *view* of values that
+  are stored elsewhere, typically in a `Dataset`. Views are as cheap to
+  copy as a pointer, and copies of a view refer to the same values. A
+  view only owns its values once they are replaced or removed.
 */
 
 class TimeSeries
@@ -22,8 +27,8 @@ public:
   using ValueType = double;
 
   using ContainerType  = std::vector<ValueType>;
-  using const_iterator = typename ContainerType::const_iterator;
-  using iterator       = typename ContainerType::iterator;
+  using const_iterator = const ValueType*;
+  using iterator       = ValueType*;
 
   // Makes it possible to create an empty time series and fill it with
   // data later on. The time series will still be valid though, but no
@@ -37,14 +42,34 @@ public:
 
   template <class InputIterator> TimeSeries( InputIterator begin, InputIterator end )
     : _values( begin, end )
+    , _data( _values.data() )
+    , _length( _values.size() )
   {
   }
 
   TimeSeries( std::initializer_list<ValueType>&& il )
     : _values( il.begin(), il.end() )
+    , _data( _values.data() )
+    , _length( _values.size() )
   {
   }
 
+  /**
+    Creates a view of n values that are stored elsewhere and have to
+    outlive the view. Optionally, the cumulative sums of the squares of
+    the values may be provided; see `squaredSums()`.
+  */
+
+  static TimeSeries view( ValueType* data, std::size_t n, const ValueType* squaredSums = nullptr ) noexcept;
+
+  // Copying a time series copies its values unless it is a view. Moving
+  // it never invalidates them, so the defaults are sufficient.
+  TimeSeries( const TimeSeries& other );
+  TimeSeries( TimeSeries&& other ) = default;
+
+  TimeSeries& operator=( const TimeSeries& other );
+  TimeSeries& operator=( TimeSeries&& other ) = default;
+
   // Operators ---------------------------------------------------------
 
   /**
@@ -71,22 +96,48 @@ public:
   // Opting for in-line implementations here because it is not worth the
   // extra trouble.
 
-  const_iterator begin() const noexcept { return _values.begin(); }
-  iterator       begin()       noexcept { return _values.begin(); }
+  const_iterator begin() const noexcept { return _data; }
+  iterator       begin()       noexcept { return _data; }
 
-  const_iterator end()   const noexcept { return _values.end(); }
-  iterator       end()         noexcept { return _values.end(); }
+  const_iterator end()   const noexcept { return _data + _length; }
+  iterator       end()         noexcept { return _data + _length; }
 
   // Access ------------------------------------------------------------
 
-  const ValueType& operator[]( std::size_t index ) const noexcept { return _values[ index ]; }
-  ValueType&       operator[]( std::size_t index )       noexcept { return _values[ index ]; }
+  const ValueType& operator[]( std::size_t index ) const noexcept { return _data[ index ]; }
+  ValueType&       operator[]( std::size_t index )       noexcept { return _data[ index ]; }
+
+  const ValueType& at( std::size_t index ) const;
+  ValueType&       at( std::size_t index );
+
+  /** Provides access to the underlying contiguous storage */
+  const ValueType* data() const noexcept { return _data; }
 
-  const ValueType& at( std::size_t index ) const { return _values.at( index ); }
-  ValueType&       at( std::size_t index )       { return _values.at( index ); }
+  /**
+    Returns the cumulative sums of the squares of the values, i.e. n+1
+    values whose k-th entry is the sum of the first k squares, summed in
+    their natural order. They are only available for views of a dataset;
+    otherwise, a null pointer is returned.
+  */
 
-  void pop_front() { _values.erase( _values.begin() ); }
-  void pop_back()  { _values.pop_back();               }
+  const ValueType* squaredSums() const noexcept { return _squaredSums; }
+
+  /**
+    Replaces the values of the time series, reusing its storage. This
+    keeps the index and the start. A view owns its values afterwards.
+  */
+
+  template <class InputIterator> void assign( InputIterator begin, InputIterator end )
+  {
+    _values.assign( begin, end );
+
+    _data        = _values.data();
+    _length      = _values.size();
+    _squaredSums = nullptr;
+  }
+
+  void pop_front();
+  void pop_back();
 
   // Attributes --------------------------------------------------------
 
@@ -97,17 +148,22 @@ public:
   unsigned start() const noexcept  { return _start;  }
 
   /** Returns current size or length of time series */
-  std::size_t size()   const noexcept { return _values.size(); }
-  std::size_t length() const noexcept { return _values.size(); }
+  std::size_t size()   const noexcept { return _length; }
+  std::size_t length() const noexcept { return _length; }
 
   /** Checks whether the current time series is empty */
-  bool empty() const noexcept { return _values.empty(); }
+  bool empty() const noexcept { return _length == 0; }
+
+  /** Checks whether the time series is a view of values stored elsewhere */
+  bool isView() const noexcept { return _data != _values.data(); }
 
   // Distance calculations ---------------------------------------------
 
   /**
     Calculates the distance from one time series to another time series,
-    which requires evaluating the distance between subsequences.
+    which requires evaluating the distance between subsequences. The
+    kernel is selected at runtime according to the instruction sets of
+    the CPU; all kernels yield the same results.
   */
 
   ValueType distance( const TimeSeries& other ) const noexcept;
@@ -119,10 +175,14 @@ private:
 
   /**
     The values making up the time series (or the individual shapelet),
-    sorted in order of appearance.
+    sorted in order of appearance. This remains empty for views.
   */
 
   ContainerType _values;
+
+  ValueType* _data              = nullptr; //< Values, either owned or those of a view
+  std::size_t _length           = 0;       //< Number of values
+  const ValueType* _squaredSums = nullptr; //< Cumulative sums of squares (optional)
 };
 
 /**
@@ -155,4 +155,12 @@ std::pair< std::vector<TimeSeries>, std::vector<bool> > readData( const std::str
 
 std::pair<double, double> standardizeData( std::vector<TimeSeries>& timeSeries );
 
+/**
+  Returns the peak memory usage, i.e. the maximum resident set size, of
+  the current process in bytes. Returns zero if the platform does not
+  permit querying it.
+*/
+
+std::size_t peakMemoryUsage();
+
 #endif
@@ -0,0 +1,46 @@
+#ifndef DISTANCES_DTW_HH__
+#define DISTANCES_DTW_HH__
+
+#include "DistanceEngine.hh"
+
+#include <sstream>
+
+/*
+  Dynamic time warping (DTW) distance between a shapelet and a time
+  series, i.e. the minimum over all windows of the length of the
+  shapelet. The cost of aligning two values is their squared difference,
+  so without any warping, this is the squared Euclidean distance.
+
+  Warping is restricted to a Sakoe-Chiba band. Its width is either an
+  absolute number of values or, if it is less than one, a fraction of
+  the length of the shapelet. Following the UCR suite, every window is
+  first checked against LB_Kim and LB_Keogh in both directions, and the
+  dynamic program, which only keeps two rows, is abandoned as soon as it
+  cannot improve upon the best distance any more.
+*/
+
+class DTWDistance : public BatchDistanceFunctor<DTWDistance>
+{
+public:
+  using ValueType = DistanceFunctor::ValueType;
+
+  DTWDistance( ValueType band );
+
+  virtual ValueType operator()( const TimeSeries& S, const TimeSeries& T ) const;
+
+  virtual std::string name() const noexcept
+  {
+    // In contrast to `std::to_string`, this uses the *default*
+    // notation for output streams, so that we get '0', instead
+    // of '0.000000'.
+    std::ostringstream stream;
+    stream << _band;
+
+    return "DTW:" + stream.str();
+  }
+
+private:
+  ValueType _band;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef DISTANCES_DISTANCE_ENGINE_HH__
+#define DISTANCES_DISTANCE_ENGINE_HH__
+
+#include "DistanceFunctor.hh"
+
+#include "TimeSeries.hh"
+
+#include <vector>
+
+/**
+  Calculates the distances between a candidate and all time series
+  with a distance *policy*, i.e. any class whose call operator takes a
+  candidate and a time series. The distance to the j-th time series is
+  stored at `distances[j]`.
+
+  Since the policy is a template parameter, its call operator is resolved
+  at compile time and may be inlined into the loop, whereas calling a
+  `DistanceFunctor` through a pointer to its base class requires one
+  virtual call per pair.
+*/
+
+template <class Distance> void calculateDistances( const Distance& distance,
+                                                   const TimeSeries& S,
+                                                   const std::vector<TimeSeries>& timeSeries,
+                                                   DistanceFunctor::ValueType* distances )
+{
+  for( std::size_t j = 0; j < timeSeries.size(); j++ )
+    distances[j] = distance( S, timeSeries[j] );
+}
+
+/**
+  Base class for the built-in distance functors, which implements their
+  batch entry point via the engine above. The derived class is passed as
+  a template parameter, so that the loop calls its main entry point
+  directly instead of dispatching every pair through the virtual table.
+*/
+
+template <class Derived> class BatchDistanceFunctor : public DistanceFunctor
+{
+public:
+  using ValueType = DistanceFunctor::ValueType;
+
+  virtual void distances( const TimeSeries& S,
+                          const std::vector<TimeSeries>& timeSeries,
+                          ValueType* distances ) const
+  {
+    auto&& self = static_cast<const Derived&>( *this );
+
+    calculateDistances(
+      [&self] ( const TimeSeries& S, const TimeSeries& T )
+      {
+        return self.Derived::operator()( S, T );
+      },
+      S,
+      timeSeries,
+      distances );
+  }
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define DISTANCE_FUNCTOR_HH__
 
 #include <string>
+#include <vector>
 
 // Using a forward reference because it is sufficient here, thus
 // minimizing the complexity of all dependencies to some extent.
@@ -29,6 +30,20 @@ public:
 
   virtual ValueType operator()( const TimeSeries& S, const TimeSeries& T ) const = 0; 
 
+  /**
+    Batch entry point for the functor. This calculates the distances
+    between a candidate and all time series, storing the distance to the
+    j-th time series at `distances[j]`, so that the functor is called
+    only once per candidate instead of once per pair.
+
+    The default implementation calls the main entry point for every time
+    series, so custom functors only need to implement the former.
+  */
+
+  virtual void distances( const TimeSeries& S,
+                          const std::vector<TimeSeries>& timeSeries,
+                          ValueType* distances ) const;
+
   /**
     Returns the name of the distance functor. Ideally, this should
     include parameters, but this function cannot enforce it.
@@ -1,11 +1,11 @@
 #ifndef DISTANCES_LP_HH__
 #define DISTANCES_LP_HH__
 
-#include "DistanceFunctor.hh"
+#include "DistanceEngine.hh"
 
 #include <sstream>
 
-class LpDistance : public DistanceFunctor
+class LpDistance : public BatchDistanceFunctor<LpDistance>
 {
 public:
   using ValueType = DistanceFunctor::ValueType;
@@ -0,0 +1,45 @@
+#ifndef DISTANCES_MASS_HH__
+#define DISTANCES_MASS_HH__
+
+#include "DistanceEngine.hh"
+
+#include <cstddef>
+
+/*
+  Squared Euclidean distance between a shapelet and a time series, i.e.
+  the minimum over all offsets, that is calculated from the *distance
+  profile* of the shapelet, following Mueen's algorithm for similarity
+  search (MASS). The sliding dot products are obtained via an FFT and
+  combined with cumulative sums of squares, which requires O(m log m)
+  operations for a time series of length m instead of O(mn) operations
+  for a shapelet of length n.
+
+  Since the profile is subject to round-off errors, all offsets whose
+  approximate distance is sufficiently close to the minimum are checked
+  again in the same way as in `TimeSeries::distance()`. Hence, both
+  functions yield the same results. Pairs with missing or infinite
+  values, which would spoil the whole profile, are passed to the scan.
+*/
+
+class MASSDistance : public BatchDistanceFunctor<MASSDistance>
+{
+public:
+  using ValueType = DistanceFunctor::ValueType;
+
+  virtual ValueType operator()( const TimeSeries& S, const TimeSeries& T ) const;
+
+  virtual std::string name() const noexcept
+  {
+    return "MASS";
+  }
+
+  /**
+    Checks whether the distance profile is expected to be cheaper than
+    the early-abandoning scan over all offsets for a shapelet of length
+    n and a time series of length m.
+  */
+
+  static bool cheaper( std::size_t n, std::size_t m ) noexcept;
+};
+
+#endif
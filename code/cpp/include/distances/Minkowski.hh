@@ -1,11 +1,13 @@
 #ifndef DISTANCES_MINKOWSKI_HH__
 #define DISTANCES_MINKOWSKI_HH__
 
-#include "DistanceFunctor.hh"
+#include "DistanceEngine.hh"
 
 #include <sstream>
 
-class MinkowskiDistance : public DistanceFunctor
+#include <cstddef>
+
+class MinkowskiDistance : public BatchDistanceFunctor<MinkowskiDistance>
 {
 public:
   using ValueType = DistanceFunctor::ValueType;
@@ -26,7 +28,14 @@ public:
   }
 
 private:
+  using Kernel = ValueType (*)( const ValueType* pattern, std::size_t n,
+                                const ValueType* sequence, std::size_t m,
+                                ValueType p );
+
   ValueType _p;
+
+  // Kernel that is selected according to the power upon construction
+  Kernel _kernel;
 };
 
 #endif
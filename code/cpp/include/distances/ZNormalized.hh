@@ -0,0 +1,33 @@
+#ifndef DISTANCES_Z_NORMALIZED_HH__
+#define DISTANCES_Z_NORMALIZED_HH__
+
+#include "DistanceEngine.hh"
+
+/*
+  Squared Euclidean distance between a z-normalized shapelet and the
+  z-normalized windows of a time series, i.e. the minimum over all
+  offsets. In contrast to standardizing the data globally, this makes
+  the distance invariant to the offset and the amplitude of every
+  window.
+
+  The mean and the standard deviation of every window are obtained in
+  constant time from cumulative sums of the time series, which are
+  calculated once per comparison. Windows are abandoned early as soon
+  as they exceed the current minimum. Windows without any variation are
+  normalized to zero.
+*/
+
+class ZNormalizedDistance : public BatchDistanceFunctor<ZNormalizedDistance>
+{
+public:
+  using ValueType = DistanceFunctor::ValueType;
+
+  virtual ValueType operator()( const TimeSeries& S, const TimeSeries& T ) const;
+
+  virtual std::string name() const noexcept
+  {
+    return "z-normalized";
+  }
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "Logging.hh"
+#include "Output.hh"
+#include "SignificantShapelets.hh"
+#include "Utilities.hh"
+#include "Version.hh"
+
+#include <boost/log/trivial.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <boost/timer/timer.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Checks whether two shards stem from the same extraction. Only the
+// index of a shard is permitted to differ.
+bool compatible( const Parameters& p, const Parameters& q )
+{
+  return p.minLength        == q.minLength
+      && p.maxLength        == q.maxLength
+      && p.stride           == q.stride
+      && p.keep             == q.keep
+      && p.allShapelets     == q.allShapelets
+      && p.disablePruning   == q.disablePruning
+      && p.mergeTables      == q.mergeTables
+      && p.removeDuplicates == q.removeDuplicates
+      && p.rtol             == q.rtol
+      && p.atol             == q.atol
+      && p.standardize      == q.standardize
+      && p.withPseudocounts == q.withPseudocounts
+      && p.mu               == q.mu
+      && p.sigma            == q.sigma
+      && p.distance         == q.distance
+      && p.precision        == q.precision
+      && p.test             == q.test
+      && p.version          == q.version;
+}
+
+int main( int argc, char** argv )
+{
+  setupLogging();
+
+  using namespace boost::program_options;
+
+  bool quiet = false;
+
+  std::vector<std::string> inputs;
+  std::string output = "-";
+
+  options_description description( "Available options" );
+  description.add_options()
+    ("help,h"  , "Show help")
+    ("quiet,q" , "Disables progress bar" )
+    ("input,i" , value< std::vector<std::string> >( &inputs ), "Shard files, as written by 's3m --shard'" )
+    ("output,o", value<std::string>( &output )               , "Output file (specify '-' for stdout)" );
+
+  positional_options_description positionalOptions;
+  positionalOptions.add( "input", -1 );
+
+  variables_map variables;
+
+  store( command_line_parser( argc, argv )
+      .options( description )
+      .positional( positionalOptions )
+      .run(),
+    variables );
+  notify( variables );
+
+  if( variables.count("help") )
+  {
+    std::cerr << description << "\n";
+    return 0;
+  }
+
+  BOOST_LOG_TRIVIAL(info) << "S3M merge (" << GIT_COMMIT_ID << ")";
+
+  if( variables.count("quiet") )
+    quiet = true;
+
+  if( inputs.empty() )
+  {
+    std::cerr << "No shard files were specified. S3M needs the evaluations of\n"
+              << "all shards of an extraction in order to merge them.\n\n"
+              << description << "\n";
+
+    return 0;
+  }
+
+  // 1. Read shard headers ---------------------------------------------
+
+  Parameters parameters;
+  unsigned numShards = 0;
+
+  std::vector< std::unique_ptr<std::ifstream> > streams;
+  std::vector<std::istream*> shards;
+  std::vector<bool> seen;
+
+  for( auto&& input : inputs )
+  {
+    BOOST_LOG_TRIVIAL(info) << "Loading shard from " << input;
+
+    std::unique_ptr<std::ifstream> in( new std::ifstream( input, std::ios::binary ) );
+    if( !*in )
+      throw std::runtime_error( "Unable to open shard file '" + input + "'" );
+
+    Parameters shardParameters;
+    unsigned shard          = 0;
+    unsigned shardNumShards = 0;
+
+    readShardHeader( *in, shardParameters, shard, shardNumShards );
+
+    if( streams.empty() )
+    {
+      parameters = shardParameters;
+      numShards  = shardNumShards;
+
+      seen.resize( numShards, false );
+    }
+    else if( !compatible( parameters, shardParameters ) || numShards != shardNumShards )
+      throw std::runtime_error( "Shard file '" + input + "' stems from a different extraction" );
+
+    if( shard >= numShards )
+      throw std::runtime_error( "Shard file '" + input + "' has an invalid shard index" );
+
+    if( seen[shard] )
+      throw std::runtime_error( "Shard " + std::to_string( shard ) + " has been specified multiple times" );
+
+    seen[shard] = true;
+
+    shards.push_back( in.get() );
+    streams.push_back( std::move( in ) );
+  }
+
+  if( shards.size() != numShards )
+    throw std::runtime_error( "Expected " + std::to_string( numShards ) + " shards, but got " + std::to_string( shards.size() ) );
+
+  if( parameters.version != GIT_COMMIT_ID )
+    BOOST_LOG_TRIVIAL(warning) << "Shards have been created by a different version of S3M (" << parameters.version << ")";
+
+  // 2. Merge the evaluations ------------------------------------------
+
+  boost::timer::cpu_timer timer;
+
+  BOOST_LOG_TRIVIAL(info) << "Merging " << numShards << " shards of an extraction with length "
+                          << "[" << parameters.minLength << ":" << parameters.maxLength << "]";
+
+  std::vector<long double> thresholds;
+  SignificantShapelets significantShapelets( parameters.minLength,
+                                             parameters.maxLength,
+                                             parameters.stride );
+
+  significantShapelets.disablePruning( parameters.disablePruning );
+  significantShapelets.mergeTables( parameters.mergeTables );
+  significantShapelets.quiet( quiet );
+  significantShapelets.removeDuplicates( parameters.removeDuplicates );
+  significantShapelets.setDuplicateTolerances( parameters.rtol, parameters.atol );
+  significantShapelets.reportAllShapelets( parameters.allShapelets );
+  significantShapelets.withPseudocounts( parameters.withPseudocounts );
+  significantShapelets.setTest( parseTest( parameters.test ) );
+
+  // Restored from the shards in order to report the shapelets
+  std::vector<TimeSeries> timeSeries;
+
+  long double p_tarone = 0.0;
+  auto shapelets       = significantShapelets.merge( shards,
+                                                     p_tarone,
+                                                     thresholds,
+                                                     timeSeries );
+
+  timer.stop();
+
+  // 3. Output ---------------------------------------------------------
+
+  {
+    std::ostream* out = &std::cout;
+    std::ofstream fout;
+    if( output != "-" and not output.empty() )
+    {
+      fout.open( output );
+      out = &fout;
+    }
+
+    writeJSON( *out, parameters, p_tarone, shapelets, timeSeries );
+  }
+
+  BOOST_LOG_TRIVIAL(info) << "Finished merging shards. Total time:" << timer.format() << "\n";
+  BOOST_LOG_TRIVIAL(info) << "Peak memory usage: " << peakMemoryUsage() / ( 1024 * 1024 ) << " MiB";
+}
@@ -1,30 +1,24 @@
+#include "CompactStorage.hh"
+#include "Dataset.hh"
+#include "Logging.hh"
+#include "Output.hh"
 #include "SignificantShapelets.hh"
+#include "SquaredEuclideanDistance.hh"
 #include "TimeSeries.hh"
 #include "Utilities.hh"
 #include "Version.hh"
 
+#include "distances/DTW.hh"
 #include "distances/DistanceFunctor.hh"
 #include "distances/Lp.hh"
+#include "distances/MASS.hh"
 #include "distances/Minkowski.hh"
+#include "distances/ZNormalized.hh"
 
-#include <boost/date_time/posix_time/posix_time.hpp>
-
-#include <boost/log/core.hpp>
-#include <boost/log/expressions.hpp>
 #include <boost/log/trivial.hpp>
 
-#include <boost/log/sinks/sync_frontend.hpp>
-#include <boost/log/sinks/text_ostream_backend.hpp>
-
-#include <boost/log/utility/formatting_ostream.hpp>
-#include <boost/log/utility/setup/common_attributes.hpp>
-
-#include <boost/make_shared.hpp>
-
 #include <boost/program_options.hpp>
 
-#include <boost/shared_ptr.hpp>
-
 #include <boost/timer/timer.hpp>
 
 #include <algorithm>
@@ -33,76 +27,11 @@
 #include <iostream>
 #include <set>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 
 #include <cmath>
 
-// Adds colours to the output of the log. This is based on an example
-// from StackOverflow [1].
-//
-// [1]: https://stackoverflow.com/a/38316911/1396991
-
-void formatLogRecord( boost::log::record_view const& r, boost::log::formatting_ostream& o )
-{
-  namespace logging = boost::log;
-  auto severity     = r[ logging::trivial::severity ];
-
-  if( severity )
-  {
-    switch( severity.get() )
-    {
-    case logging::trivial::info:
-      o << "\033[32m";
-      break;
-    case logging::trivial::warning:
-      o << "\033[33m";
-      break;
-    case logging::trivial::error:
-    case logging::trivial::fatal:
-      o << "\033[31m";
-      break;
-    default:
-      break;
-    }
-  }
-
-  auto timeStamp = logging::extract<boost::posix_time::ptime>("TimeStamp", r);
-
-  o << boost::posix_time::to_simple_string( *timeStamp ) << ": "
-    << r[ logging::expressions::smessage ];
-
-  // Restore the default colour
-  if( severity )
-    o << "\033[0m";
-  // Silence compiler warnings if Boost.Log is not present in the
-  // platform.
-  (void) r;
-  (void) o;
-}
-
-void setupLogging()
-{
-  namespace logging = boost::log;
-  auto core         = logging::core::get();
-
-  logging::add_common_attributes();
-
-  boost::shared_ptr<logging::sinks::text_ostream_backend> backend
-    = boost::make_shared<logging::sinks::text_ostream_backend>();
-
-  backend->add_stream(
-    boost::shared_ptr<std::ostream>( &std::clog, []( std::ostream* ) {} )
-  );
-
-  backend->auto_flush( true );
-
-  using Sink = logging::sinks::synchronous_sink<logging::sinks::text_ostream_backend>;
-  boost::shared_ptr<Sink> sink( new Sink( backend ) );
-
-  sink->set_formatter( &formatLogRecord );
-  core->add_sink( sink );
-}
-
 std::shared_ptr<DistanceFunctor> selectDistance( const std::string& name )
 {
   auto position = name.find( ':' );
@@ -116,6 +45,17 @@ std::shared_ptr<DistanceFunctor> selectDistance( const std::string& name )
   else if( metric == "lp" )
     return std::make_shared<LpDistance>( p );
 
+  else if( metric == "mass" )
+    return std::make_shared<MASSDistance>();
+
+  else if( metric == "znorm" )
+    return std::make_shared<ZNormalizedDistance>();
+
+  // The parameter is the width of the band; if it is omitted, warping is
+  // restricted to 10% of the length of the shapelet.
+  else if( metric == "dtw" )
+    return std::make_shared<DTWDistance>( power.empty() ? 0.1 : p );
+
   // Fall back to the default distance here instead of selecting one
   // that does not fit.
   return std::make_shared<MinkowskiDistance>( 2.0 );
@@ -128,6 +68,8 @@ int main( int argc, char** argv )
   using namespace boost::program_options;
 
   bool allShapelets         = false;
+  bool batchCandidates      = false;
+  bool hugePages            = false;
   bool standardize          = false;
   bool disablePruning       = false;
   bool mergeTables          = false;
@@ -140,11 +82,18 @@ int main( int argc, char** argv )
   unsigned s = 0; // stride
   unsigned l = 0; // label index in time series
   unsigned k = 0; // number of significant shapelets to keep
+  unsigned j = 1; // number of threads
+
+  double rtol = 1e-6; // relative tolerance for duplicates
+  double atol = 1e-8; // absolute tolerance for duplicates
 
   std::string excludeColumns;
   std::string distance;
+  std::string precision;
+  std::string test;
   std::string input;
   std::string output = "-";
+  std::string shard;
 
   options_description description( "Available options" );
   description.add_options()
@@ -156,15 +105,23 @@ int main( int argc, char** argv )
     ("remove-duplicates,r"    , "Remove duplicates" )
     ("with-pseudocounts,c"    , "Use pseudocounts in contingency tables" )
     ("quiet,q"                , "Disables progress bar" )
+    ("batch"                  , "Compare batches of candidates to every time series at once (only for a single length, i.e. without -M)" )
+    ("huge-pages"             , "Store the time series in huge pages (Linux only)" )
     ("min-length,m"           , value<unsigned>( &m )->default_value( 10 ), "Minimum candidate pattern length" )
     ("max-length,M"           , value<unsigned>( &M )->default_value(  0 ), "Maximum candidate pattern length" )
     ("stride,s"               , value<unsigned>( &s )->default_value(  1 ), "Stride" )
     ("label-index,l"          , value<unsigned>( &l )->default_value(  0 ), "Index of label in time series" )
     ("keep,k"                 , value<unsigned>( &k )->default_value(  0 ), "Maximum number of shapelets to keep (0 = unlimited" )
+    ("threads,j"              , value<unsigned>( &j )->default_value(  1 ), "Number of threads for evaluating candidates (0 = all cores)" )
+    ("rtol"                   , value<double>( &rtol )->default_value( 1e-6 ), "Relative tolerance for duplicate removal" )
+    ("atol"                   , value<double>( &atol )->default_value( 1e-8 ), "Absolute tolerance for duplicate removal" )
     ("distance,d"             , value<std::string>( &distance )           , "Use non-standard distance function")
+    ("test"                   , value<std::string>( &test )->default_value( "chi2" ), "Statistical test for contingency tables (chi2, fisher)" )
+    ("precision"              , value<std::string>( &precision )->default_value( "double" ), "Precision for storing time series in distance calculations (double, float, int16); reduces the memory bandwidth, while the values are still kept in double precision for the output" )
     ("exclude-columns,e"      , value<std::string>( &excludeColumns )     , "Columns to exclude for shapelet processing" )
     ("input,i"                , value<std::string>( &input )              , "Training file" )
-    ("output,o"               , value<std::string>( &output )             , "Output file (specify '-' for stdout)" );
+    ("output,o"               , value<std::string>( &output )             , "Output file (specify '-' for stdout)" )
+    ("shard"                  , value<std::string>( &shard )              , "Only evaluate shard 'i/N' of all candidates and store the evaluations for 's3m-merge'" );
 
   positional_options_description positionalOptions;
   positionalOptions.add( "input", 1 );
@@ -202,9 +159,18 @@ int main( int argc, char** argv )
   if( variables.count("quiet") )
     quiet = true;
 
+  if( variables.count("batch") )
+    batchCandidates = true;
+
+  if( variables.count("huge-pages") )
+    hugePages = true;
+
   if( variables.count("remove-duplicates") )
     removeDuplicates = true;
 
+  if( rtol < 0.0 || atol < 0.0 )
+    throw std::runtime_error( "Tolerances for duplicate removal must not be negative" );
+
   if( variables.count("standardize") )
     standardize = true;
 
@@ -242,14 +208,28 @@ int main( int argc, char** argv )
     }
   }
 
-  auto data         = readData( input, l, excludedColumns );
-  auto&& timeSeries = data.first;
-  auto&& labels     = data.second;
+  auto data   = readData( input, l, excludedColumns );
+  auto&& labels = data.second;
 
   BOOST_LOG_TRIVIAL(info) << "Read "
-                          << timeSeries.size()
+                          << data.first.size()
                           << " time series from training input file";
 
+  // Compact storage is set up during the extraction, so the values are
+  // checked here in order to fail early. Missing values are supported by
+  // all precisions, but 16-bit integers do not have infinite values.
+  if( parsePrecision( precision ) == Precision::Int16 )
+  {
+    for( auto&& T : data.first )
+    {
+      if( std::any_of( T.begin(), T.end(), [] ( double value ) { return std::isinf( value ); } ) )
+      {
+        std::cerr << "Infinite values cannot be stored with precision int16; please use 'float' or 'double' instead\n";
+        return -1;
+      }
+    }
+  }
+
   double mu    = 0.0;
   double sigma = 1.0;
 
@@ -260,11 +240,29 @@ int main( int argc, char** argv )
     // Store the parameters in order to undo the standardization
     // procedure afterwards.
     std::tie( mu, sigma )
-      = standardizeData( timeSeries );
+      = standardizeData( data.first );
 
     BOOST_LOG_TRIVIAL(info) << "Finished data standardization";
   }
 
+  // All subsequent calculations use views of a single contiguous buffer;
+  // the time series that have been read are not required any more. The
+  // values in double precision are always kept for reporting shapelets,
+  // but compact storage replaces them in the distance calculations, so
+  // their squared sums are only required for the default distance in
+  // double precision.
+  bool squaredSums = parsePrecision( precision ) == Precision::Double && distance.empty();
+
+  Dataset dataset( data.first, hugePages, squaredSums );
+  data.first = std::vector<TimeSeries>();
+
+  auto&& timeSeries = dataset.timeSeries();
+
+  BOOST_LOG_TRIVIAL(info) << "Stored time series in " << dataset.bytes() << " bytes";
+
+  if( hugePages && !dataset.hugePages() )
+    BOOST_LOG_TRIVIAL(warning) << "Unable to use huge pages for storing the time series";
+
   // 2. Perform the extraction -----------------------------------------
 
   boost::timer::cpu_timer timer;
@@ -274,6 +272,11 @@ int main( int argc, char** argv )
   if( m > M )
     M = m;
 
+  // Use all available cores; the function is allowed to return zero if
+  // the number of cores cannot be determined.
+  if( j == 0 )
+    j = std::max( 1u, std::thread::hardware_concurrency() );
+
   BOOST_LOG_TRIVIAL(info) << "Extracting shapelets with length "
                           << "[" << m << ":" << M << "]";
 
@@ -284,103 +287,108 @@ int main( int argc, char** argv )
   // the default implementation is much faster.
   if( !distance.empty() )
     significantShapelets.setDistance( selectDistance( distance) );
+  else
+    BOOST_LOG_TRIVIAL(info) << "Using " << name( detectInstructionSet() ) << " kernel for distance calculations";
 
   significantShapelets.disablePruning( disablePruning );             // enable/disable pruning
   significantShapelets.mergeTables( mergeTables );                   // enable/disable merging of contingency tables
   significantShapelets.quiet( quiet );                               // enable/disable progress bar display
   significantShapelets.removeDuplicates( removeDuplicates );         // enable/disable duplicate removal upon extraction
+  significantShapelets.setDuplicateTolerances( rtol, atol );         // tolerances for duplicate removal
   significantShapelets.reportAllShapelets( allShapelets );           // enable/disable pruning based on significance threshold
   significantShapelets.withPseudocounts( withPseudocounts );         // enable use of pseudocounts for contingency tables
-
-  long double p_tarone = 0.0;
-  auto shapelets       = significantShapelets( timeSeries,
-                                               labels,
-                                               p_tarone,
-                                               thresholds );
-
-  timer.stop();
-
-  if( standardize )
-  {
-    using SignificantShapelet = SignificantShapelets::SignificantShapelet;
-
-    std::transform(
-      shapelets.begin(), shapelets.end(), shapelets.begin(),
-        [&mu, &sigma] ( SignificantShapelet ss )
-        {
-          using ValueType  = typename TimeSeries::ValueType;
-          auto && shapelet = ss.shapelet;
-
-          std::transform( shapelet.begin(), shapelet.end(), shapelet.begin(),
-            [&mu, &sigma] ( ValueType x )
-            {
-              return (x * sigma) + mu;
-            }
-          );
-
-          return ss;
-        }
-    );
-  }
+  significantShapelets.setNumThreads( j );                           // number of threads for evaluating candidates
+  significantShapelets.batchCandidates( batchCandidates );           // enable/disable batched evaluation of candidates
+  significantShapelets.setPrecision( parsePrecision( precision ) );  // precision for storing time series
+  significantShapelets.setTest( parseTest( test ) );                 // statistical test for contingency tables
 
   if( withPseudocounts )
     BOOST_LOG_TRIVIAL(info) << "Using pseudocounts for contingency table calculation";
 
-  // 3. Output ---------------------------------------------------------
-  //
+  Parameters parameters;
+
+  parameters.minLength        = m;
+  parameters.maxLength        = M;
+  parameters.stride           = s;
+  parameters.keep             = k;
+  parameters.allShapelets     = allShapelets;
+  parameters.disablePruning   = disablePruning;
+  parameters.mergeTables      = mergeTables;
+  parameters.removeDuplicates = removeDuplicates;
+  parameters.rtol             = rtol;
+  parameters.atol             = atol;
+  parameters.standardize      = standardize;
+  parameters.withPseudocounts = withPseudocounts;
+  parameters.precision        = name( parsePrecision( precision ) );
+  parameters.test             = name( parseTest( test ) );
+  parameters.mu               = mu;
+  parameters.sigma            = sigma;
+  parameters.version          = GIT_COMMIT_ID;
+
+  // This is a *little* bit inefficient since we already set the functor
+  // above, but I do not want to write yet another 'get' function for the
+  // significant shapelets class.
+  if( !distance.empty() )
+    parameters.distance = selectDistance( distance )->name();
+
   // The fiddling with the pointer below is only required in order to
   // be able to handle both file outputs and outputs to `stdout`. C++
   // makes this a very strange case to handle.
+  std::ostream* out = &std::cout;
+  std::ofstream fout;
+  if( output != "-" and not output.empty() )
+  {
+    // Shards are stored in a binary format
+    fout.open( output, shard.empty() ? std::ios::out : std::ios::out | std::ios::binary );
+    out = &fout;
+  }
 
+  // Only evaluate a subset of all candidates and store the evaluations;
+  // the results have to be merged with those of the other shards.
+  if( !shard.empty() )
   {
-    std::ostream* out = &std::cout;
-    std::ofstream fout;
-    if( output != "-" and not output.empty() )
+    unsigned shardIndex = 0;
+    unsigned numShards  = 0;
+
     {
-      fout.open( output );
-      out = &fout;
-    }
+      auto tokens = split( shard, std::string( "/" ) );
+      if( tokens.size() != 2 )
+        throw std::runtime_error( "Shard must be specified as 'i/N'" );
 
-    *out << std::setprecision( 32 );
+      shardIndex = convert<unsigned>( tokens.front() );
+      numShards  = convert<unsigned>( tokens.back() );
 
-    *out << "{\n"
-         << "  \"parameters\": {\n"
-         << "    \"min_length\": "  << m << ",\n"
-         << "    \"max_length\": "  << M << ",\n"
-         << "    \"stride\": "      << s << ",\n"
-         << "    \"standardize\": " << std::boolalpha << standardize << std::noboolalpha << ",\n";
+      if( numShards == 0 || shardIndex >= numShards )
+        throw std::runtime_error( "Shard index must be smaller than the number of shards" );
+    }
 
-    // Only add this section if we deviated from the default distance.
-    // We do not want to clutter up the output.
-    if( !distance.empty() )
-    {
-      // This is a *little* bit inefficient since we already set the
-      // functor above, but I do not want to write yet another 'get'
-      // function for the significant shapelets class.
-      auto functor = selectDistance( distance);
+    writeShardHeader( *out, parameters, shardIndex, numShards );
 
-      *out << "    \"distance\": " << "\"" << functor->name() << "\",\n";
-    }
+    significantShapelets( timeSeries,
+                          labels,
+                          shardIndex,
+                          numShards,
+                          *out );
 
-    *out << "    \"p_tarone\": "    << p_tarone << ",\n"
-         << "    \"version\": "     << "\"" << GIT_COMMIT_ID << "\"\n"
-         << "  },\n"
-         << "  \"shapelets\": [\n";
+    timer.stop();
 
-    if( k != 0 && k < shapelets.size() )
-      shapelets.resize( k );
+    BOOST_LOG_TRIVIAL(info) << "Finished evaluation of shard " << shardIndex << "/" << numShards << ". Total time:" << timer.format() << "\n";
+    BOOST_LOG_TRIVIAL(info) << "Peak memory usage: " << peakMemoryUsage() / ( 1024 * 1024 ) << " MiB";
+    return 0;
+  }
 
-    for( auto it = shapelets.begin(); it != shapelets.end(); ++it )
-    {
-      if( it != shapelets.begin() )
-        *out << ",\n";
+  long double p_tarone = 0.0;
+  auto shapelets       = significantShapelets( timeSeries,
+                                               labels,
+                                               p_tarone,
+                                               thresholds );
 
-      *out << *it;
-    }
+  timer.stop();
 
-    *out << "  ]\n"
-         << "}\n";
-  }
+  // 3. Output ---------------------------------------------------------
+
+  writeJSON( *out, parameters, p_tarone, shapelets, timeSeries );
 
   BOOST_LOG_TRIVIAL(info) << "Finished shapelet extraction. Total time:" << timer.format() << "\n";
+  BOOST_LOG_TRIVIAL(info) << "Peak memory usage: " << peakMemoryUsage() / ( 1024 * 1024 ) << " MiB";
 }
@@ -0,0 +1,538 @@
+#include "BatchedDistances.hh"
+#include "SquaredEuclideanDistance.hh"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include <cassert>
+#include <cmath>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+  #define S3M_X86_KERNELS
+  #include <immintrin.h>
+#endif
+
+namespace
+{
+
+// Size of the register blocks of the dot product kernel, i.e. the number
+// of candidates and the number of windows that are handled at once.
+constexpr std::size_t blockCandidates = 4;
+constexpr std::size_t blockWindows    = 8;
+
+/**
+  Calculates the dot products of a block of candidates and a block of
+  windows. The candidates are stored consecutively, with a stride of n
+  values, while the windows start at consecutive offsets of the values.
+*/
+
+void dotProducts( const double* candidates, std::size_t n,
+                  const double* values,
+                  double ( &result )[blockCandidates][blockWindows] ) noexcept
+{
+  for( std::size_t a = 0; a < blockCandidates; a++ )
+    for( std::size_t b = 0; b < blockWindows; b++ )
+      result[a][b] = 0.0;
+
+  for( std::size_t j = 0; j < n; j++ )
+  {
+    for( std::size_t a = 0; a < blockCandidates; a++ )
+    {
+      auto x = candidates[ a * n + j ];
+
+      for( std::size_t b = 0; b < blockWindows; b++ )
+        result[a][b] += x * values[ b + j ];
+    }
+  }
+}
+
+#ifdef S3M_X86_KERNELS
+
+// Vectorized variants of the kernel above; since all approximations are
+// refined afterwards, fused multiply-adds may be used here.
+
+__attribute__(( target( "avx2,fma" ) ))
+void avx2DotProducts( const double* candidates, std::size_t n,
+                      const double* values,
+                      double ( &result )[blockCandidates][blockWindows] ) noexcept
+{
+  __m256d sums[blockCandidates][2];
+
+  for( std::size_t a = 0; a < blockCandidates; a++ )
+    sums[a][0] = sums[a][1] = _mm256_setzero_pd();
+
+  for( std::size_t j = 0; j < n; j++ )
+  {
+    auto v0 = _mm256_loadu_pd( values + j     );
+    auto v1 = _mm256_loadu_pd( values + j + 4 );
+
+    for( std::size_t a = 0; a < blockCandidates; a++ )
+    {
+      auto x     = _mm256_set1_pd( candidates[ a * n + j ] );
+      sums[a][0] = _mm256_fmadd_pd( x, v0, sums[a][0] );
+      sums[a][1] = _mm256_fmadd_pd( x, v1, sums[a][1] );
+    }
+  }
+
+  for( std::size_t a = 0; a < blockCandidates; a++ )
+  {
+    _mm256_storeu_pd( result[a],     sums[a][0] );
+    _mm256_storeu_pd( result[a] + 4, sums[a][1] );
+  }
+}
+
+__attribute__(( target( "avx512f" ) ))
+void avx512DotProducts( const double* candidates, std::size_t n,
+                        const double* values,
+                        double ( &result )[blockCandidates][blockWindows] ) noexcept
+{
+  __m512d sums[blockCandidates];
+
+  for( std::size_t a = 0; a < blockCandidates; a++ )
+    sums[a] = _mm512_setzero_pd();
+
+  for( std::size_t j = 0; j < n; j++ )
+  {
+    auto v = _mm512_loadu_pd( values + j );
+
+    for( std::size_t a = 0; a < blockCandidates; a++ )
+      sums[a] = _mm512_fmadd_pd( _mm512_set1_pd( candidates[ a * n + j ] ), v, sums[a] );
+  }
+
+  for( std::size_t a = 0; a < blockCandidates; a++ )
+    _mm512_storeu_pd( result[a], sums[a] );
+}
+
+#endif
+
+/**
+  Calculates the squared Euclidean distance of a candidate to a single
+  window with early abandoning, using the same summation order as the
+  regular distance calculation.
+*/
+
+double windowDistance( const double* candidate, std::size_t n, const double* window, double distance ) noexcept
+{
+  double temp = 0.0;
+  for( std::size_t j = 0; j < n; j++ )
+  {
+    auto x = window[j];
+    auto y = candidate[j];
+
+    temp += (x-y) * (x-y);
+
+    if( temp > distance )
+      break;
+  }
+
+  return temp;
+}
+
+// Window whose approximate distance might be the minimum one, stored as
+// a pair of the approximation and the offset of the window.
+using Window = std::pair<double, std::size_t>;
+
+/**
+  Calculates the actual distance of a candidate from the windows whose
+  approximation might be the minimum one. Windows that cannot beat the
+  final bound any more, taking the tolerance of the candidate and the
+  errors of the windows into account, are skipped.
+*/
+
+double refine( const double* candidate, std::size_t n,
+               const double* values,
+               std::vector<Window>& windows,
+               double bound,
+               double tolerance,
+               const std::vector<double>& errors )
+{
+  windows.erase( std::remove_if( windows.begin(), windows.end(),
+                                 [&] ( const Window& window )
+                                 {
+                                   return window.first - tolerance - errors[window.second] > bound;
+                                 } ),
+                 windows.end() );
+
+  std::sort( windows.begin(), windows.end() );
+
+  auto distance = std::numeric_limits<double>::max();
+
+  for( auto&& window : windows )
+  {
+    distance = std::min( distance, windowDistance( candidate, n, values + window.second, distance ) );
+
+    // This is the closest possible distance, so we might as well stop
+    // calculating here.
+    if( distance == 0.0 )
+      break;
+  }
+
+  return distance;
+}
+
+} // end of anonymous namespace
+
+void batchedDistances( const std::vector<const TimeSeries*>& candidates,
+                       const std::vector<TimeSeries>& timeSeries,
+                       std::vector<double>& distances )
+{
+  distances.assign( candidates.size() * timeSeries.size(), 0.0 );
+
+  if( candidates.empty() )
+    return;
+
+  auto n = candidates.front()->length();
+
+  assert( std::all_of( candidates.begin(), candidates.end(),
+                       [n] ( const TimeSeries* candidate ) { return candidate->length() == n; } ) );
+
+  if( n == 0 )
+    return;
+
+  constexpr double epsilon = std::numeric_limits<double>::epsilon();
+
+  // The AVX2 kernel requires fused multiply-adds as well, which are
+  // supported by all CPUs that support AVX-512.
+  static const InstructionSet instructionSet = [] ()
+  {
+    auto instructionSet = detectInstructionSet();
+
+#ifdef S3M_X86_KERNELS
+    if( instructionSet == InstructionSet::AVX2 && !__builtin_cpu_supports( "fma" ) )
+      instructionSet = InstructionSet::SSE2;
+#endif
+
+    return instructionSet;
+  }();
+
+  // Buffers are re-used for all batches that are processed by a thread
+  // in order to prevent repeated allocations.
+  thread_local std::vector<double> block;
+  thread_local std::vector<double> norms;
+  thread_local std::vector<double> values;
+  thread_local std::vector<double> cumulative;
+  thread_local std::vector<double> windowNorms;
+  thread_local std::vector<double> errors;
+  thread_local std::vector<double> bounds;
+  thread_local std::vector< std::vector<Window> > offsets;
+
+  // Candidates are stored consecutively and padded with zeros to fill
+  // the last block.
+  auto numCandidates = candidates.size();
+  auto numPadded     = ( numCandidates + blockCandidates - 1 ) / blockCandidates * blockCandidates;
+
+  block.assign( numPadded * n, 0.0 );
+  norms.assign( numPadded, 0.0 );
+
+  for( std::size_t i = 0; i < numCandidates; i++ )
+  {
+    std::copy( candidates[i]->begin(), candidates[i]->end(), block.begin() + long( i * n ) );
+
+    for( std::size_t j = 0; j < n; j++ )
+      norms[i] += (*candidates[i])[j] * (*candidates[i])[j];
+  }
+
+  for( std::size_t s = 0; s < timeSeries.size(); s++ )
+  {
+    auto&& T = timeSeries[s];
+    auto m   = T.length();
+
+    // Time series of a dataset provide their cumulative sums already
+    auto sums = T.squaredSums();
+
+    if( !sums )
+    {
+      cumulative.resize( m + 1 );
+      cumulative[0] = 0.0;
+
+      for( std::size_t k = 0; k < m; k++ )
+        cumulative[k+1] = cumulative[k] + T[k] * T[k];
+
+      sums = cumulative.data();
+    }
+
+    // Candidates that are longer than the time series are handled by the
+    // regular distance calculation, which exchanges both of them. This is
+    // also required for missing values, which would spoil the cumulative
+    // sums of all subsequent windows.
+    if( n > m || std::isnan( sums[m] ) )
+    {
+      for( std::size_t i = 0; i < numCandidates; i++ )
+        distances[ i * timeSeries.size() + s ] = candidates[i]->distance( T );
+
+      continue;
+    }
+
+    auto numWindows = m - n + 1;
+    auto numBlocks  = ( numWindows + blockWindows - 1 ) / blockWindows;
+
+    // The values are padded with zeros to fill the last block
+    values.assign( numBlocks * blockWindows + n - 1, 0.0 );
+    std::copy( T.begin(), T.end(), values.begin() );
+
+    // The error of every approximation is bounded by a small multiple of
+    // the norms of the candidate and of the window, plus the error of the
+    // cumulative sums. The bound is rather conservative, but it only has
+    // an effect on the number of windows that have to be checked again.
+    auto gamma = 2.0 * double( n + 4 ) * epsilon;
+
+    windowNorms.resize( numWindows );
+    errors.resize( numWindows );
+
+    for( std::size_t w = 0; w < numWindows; w++ )
+    {
+      windowNorms[w] = sums[w + n] - sums[w];
+      errors[w]      = gamma * windowNorms[w] + 2.0 * double( w + n + 1 ) * epsilon * sums[w + n];
+    }
+
+    // Approximate distances -------------------------------------------
+    //
+    // Every candidate keeps an upper bound of its actual distance, as well
+    // as the windows whose approximation might beat the current bound.
+
+    bounds.assign( numPadded, std::numeric_limits<double>::max() );
+    offsets.resize( numPadded );
+
+    for( auto&& windows : offsets )
+      windows.clear();
+
+    for( std::size_t w = 0; w < numWindows; w += blockWindows )
+    {
+      for( std::size_t i = 0; i < numPadded; i += blockCandidates )
+      {
+        double result[blockCandidates][blockWindows];
+
+        switch( instructionSet )
+        {
+#ifdef S3M_X86_KERNELS
+        case InstructionSet::AVX512:
+          avx512DotProducts( block.data() + i * n, n, values.data() + w, result );
+          break;
+        case InstructionSet::AVX2:
+          avx2DotProducts( block.data() + i * n, n, values.data() + w, result );
+          break;
+#endif
+        default:
+          dotProducts( block.data() + i * n, n, values.data() + w, result );
+          break;
+        }
+
+        for( std::size_t a = 0; a < blockCandidates; a++ )
+        {
+          auto norm      = norms[i + a];
+          auto tolerance = gamma * norm;
+          auto&& bound   = bounds[i + a];
+
+          for( std::size_t b = 0; b < blockWindows && w + b < numWindows; b++ )
+          {
+            auto approximation = norm - 2 * result[a][b] + windowNorms[w + b];
+
+            if( approximation - tolerance - errors[w + b] <= bound )
+            {
+              offsets[i + a].emplace_back( approximation, w + b );
+              bound = std::min( bound, approximation + tolerance + errors[w + b] );
+            }
+          }
+        }
+      }
+    }
+
+    // Refinement ------------------------------------------------------
+
+    for( std::size_t i = 0; i < numCandidates; i++ )
+    {
+      auto distance = refine( block.data() + i * n, n,
+                              T.data(),
+                              offsets[i],
+                              bounds[i],
+                              gamma * norms[i],
+                              errors );
+
+      distances[ i * timeSeries.size() + s ] = distance;
+    }
+  }
+}
+
+void slidingDistances( const TimeSeries& parent,
+                       std::size_t start,
+                       std::size_t n,
+                       std::size_t numCandidates,
+                       const std::vector<TimeSeries>& timeSeries,
+                       std::vector<double>& distances )
+{
+  assert( start + n + numCandidates - 1 <= parent.length() );
+
+  distances.assign( numCandidates * timeSeries.size(), 0.0 );
+
+  if( numCandidates == 0 || n == 0 )
+    return;
+
+  constexpr double epsilon = std::numeric_limits<double>::epsilon();
+
+  auto x = parent.data() + start;
+
+  // Norms of all candidates and the largest magnitude of their values,
+  // which bounds the errors of the updates.
+  std::vector<double> norms( numCandidates, 0.0 );
+
+  double maxCandidate = 0.0;
+  bool missing        = false;
+
+  for( std::size_t k = 0; k < numCandidates; k++ )
+  {
+    for( std::size_t j = 0; j < n; j++ )
+      norms[k] += x[k + j] * x[k + j];
+  }
+
+  for( std::size_t j = 0; j < n + numCandidates - 1; j++ )
+  {
+    maxCandidate = std::max( maxCandidate, std::abs( x[j] ) );
+    missing      = missing || std::isnan( x[j] );
+  }
+
+  thread_local std::vector<double> cumulative;
+  thread_local std::vector<double> windowNorms;
+  thread_local std::vector<double> errors;
+  thread_local std::vector<double> dotProducts;
+  thread_local std::vector<double> previous;
+  thread_local std::vector<double> approximations;
+  thread_local std::vector<Window> windows;
+
+  for( std::size_t s = 0; s < timeSeries.size(); s++ )
+  {
+    auto&& T = timeSeries[s];
+    auto m   = T.length();
+    auto y   = T.data();
+
+    auto sums = T.squaredSums();
+
+    if( !sums )
+    {
+      cumulative.resize( m + 1 );
+      cumulative[0] = 0.0;
+
+      for( std::size_t l = 0; l < m; l++ )
+        cumulative[l+1] = cumulative[l] + y[l] * y[l];
+
+      sums = cumulative.data();
+    }
+
+    double maxSeries = 0.0;
+
+    for( std::size_t l = 0; l < m; l++ )
+      maxSeries = std::max( maxSeries, std::abs( y[l] ) );
+
+    // Candidates that are longer than the time series are handled by the
+    // regular distance calculation, which exchanges both of them. This is
+    // also required for missing values, which would spoil the cumulative
+    // sums and all subsequent updates.
+    if( n > m || missing || std::isnan( sums[m] ) )
+    {
+      for( std::size_t k = 0; k < numCandidates; k++ )
+      {
+        distances[ k * timeSeries.size() + s ]
+          = n <= m ? squaredEuclideanDistance( x + k, n, y, m )
+                   : squaredEuclideanDistance( y, m, x + k, n );
+      }
+
+      continue;
+    }
+
+    auto numWindows = m - n + 1;
+    auto gamma      = 2.0 * double( n + 4 ) * epsilon;
+
+    windowNorms.resize( numWindows );
+    errors.resize( numWindows );
+
+    for( std::size_t l = 0; l < numWindows; l++ )
+    {
+      windowNorms[l] = sums[l + n] - sums[l];
+      errors[l]      = gamma * windowNorms[l] + 2.0 * double( l + n + 1 ) * epsilon * sums[l + n];
+    }
+
+    // Every update may add an error of a few units in the last place of
+    // the magnitude of the dot products, which is bounded in terms of the
+    // largest values.
+    auto drift = 8.0 * double( n + 2 ) * epsilon * maxCandidate * maxSeries;
+
+    dotProducts.resize( numWindows );
+    previous.resize( numWindows );
+    approximations.resize( numWindows );
+
+    for( std::size_t k = 0; k < numCandidates; k++ )
+    {
+      if( k == 0 )
+      {
+        // Iterating over the windows in the inner loop keeps the sums of
+        // all of them independent of each other.
+        std::fill( dotProducts.begin(), dotProducts.end(), 0.0 );
+
+        double* q = dotProducts.data();
+
+        for( std::size_t j = 0; j < n; j++ )
+        {
+          auto a = x[j];
+          for( std::size_t l = 0; l < numWindows; l++ )
+            q[l] += a * y[l + j];
+        }
+      }
+      else
+      {
+        // The first window has no predecessor, so its dot product has to
+        // be calculated directly.
+        std::swap( dotProducts, previous );
+
+        const double* p = previous.data();
+        double* q       = dotProducts.data();
+        auto a          = x[k-1];
+        auto b          = x[k+n-1];
+
+        for( std::size_t l = 1; l < numWindows; l++ )
+          q[l] = p[l-1] - a * y[l-1] + b * y[l+n-1];
+
+        double dotProduct = 0.0;
+        for( std::size_t j = 0; j < n; j++ )
+          dotProduct += x[k + j] * y[j];
+
+        q[0] = dotProduct;
+      }
+
+      auto tolerance = gamma * norms[k] + double( k ) * drift;
+
+      // Contrary to the batched calculation, the approximations are cheap
+      // enough for the search of the minimum to become a bottleneck. The
+      // bound is thus determined in a separate pass with independent
+      // minima, which does not depend on the result of the previous step.
+      double minima[4] = { std::numeric_limits<double>::max(),
+                           std::numeric_limits<double>::max(),
+                           std::numeric_limits<double>::max(),
+                           std::numeric_limits<double>::max() };
+
+      for( std::size_t l = 0; l < numWindows; l++ )
+      {
+        approximations[l] = norms[k] - 2 * dotProducts[l] + windowNorms[l];
+        minima[l % 4]     = std::min( minima[l % 4], approximations[l] + errors[l] );
+      }
+
+      auto bound = std::min( std::min( minima[0], minima[1] ), std::min( minima[2], minima[3] ) ) + tolerance;
+
+      windows.clear();
+
+      for( std::size_t l = 0; l < numWindows; l++ )
+      {
+        if( approximations[l] - tolerance - errors[l] <= bound )
+          windows.emplace_back( approximations[l], l );
+      }
+
+      distances[ k * timeSeries.size() + s ] = refine( x + k, n, y, windows, bound, tolerance, errors );
+    }
+  }
+}
+
+bool slidingDistancesCheaper( std::size_t n ) noexcept
+{
+  // Determined empirically; below this length, both variants are mostly
+  // limited by the calculation of the window norms and the refinement.
+  return n >= 48;
+}
@@ -0,0 +1,228 @@
+#include "CompactStorage.hh"
+#include "SquaredEuclideanDistance.hh"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+
+// Largest number of decimals that is tried for storing the values as
+// scaled integers without any loss
+constexpr int maxDecimals = 4;
+
+constexpr double maxInteger = double( std::numeric_limits<std::int16_t>::max() );
+
+// Code of a missing value; it lies outside of the symmetric range of the
+// stored values.
+constexpr std::int16_t missingValue = std::numeric_limits<std::int16_t>::min();
+
+/**
+  Checks whether all values are representable as 16-bit integers after
+  multiplying them by the given factor, such that dividing the integers
+  by the same factor yields the original values again. Missing values
+  are stored separately, so they are always representable.
+*/
+
+bool representable( const std::vector<TimeSeries>& timeSeries, double factor )
+{
+  for( auto&& T : timeSeries )
+  {
+    for( auto&& value : T )
+    {
+      if( std::isnan( value ) )
+        continue;
+
+      auto k = std::round( value * factor );
+
+      if( std::abs( k ) > maxInteger || k / factor != value )
+        return false;
+    }
+  }
+
+  return true;
+}
+
+} // end of anonymous namespace
+
+Precision parsePrecision( const std::string& name )
+{
+  if( name == "double" )
+    return Precision::Double;
+  else if( name == "float" )
+    return Precision::Float;
+  else if( name == "int16" )
+    return Precision::Int16;
+
+  throw std::runtime_error( "Unknown precision '" + name + "'" );
+}
+
+std::string name( Precision precision )
+{
+  switch( precision )
+  {
+  case Precision::Float:
+    return "float";
+  case Precision::Int16:
+    return "int16";
+  default:
+    return "double";
+  }
+}
+
+CompactStorage::CompactStorage( const std::vector<TimeSeries>& timeSeries, Precision precision )
+  : _precision( precision )
+{
+  if( _precision == Precision::Double )
+    throw std::runtime_error( "Compact storage requires a precision other than double" );
+
+  _offsets.reserve( timeSeries.size() + 1 );
+  _offsets.push_back( 0 );
+
+  for( auto&& T : timeSeries )
+  {
+    _offsets.push_back( _offsets.back() + T.length() );
+
+    for( auto&& value : T )
+    {
+      if( std::isinf( value ) && _precision == Precision::Int16 )
+        throw std::runtime_error( "Infinite values cannot be stored as 16-bit integers" );
+
+      if( std::isfinite( value ) )
+        _maxValue = std::max( _maxValue, std::abs( value ) );
+    }
+  }
+
+  if( _precision == Precision::Float )
+  {
+    _floats.reserve( _offsets.back() );
+
+    for( auto&& T : timeSeries )
+    {
+      for( auto&& value : T )
+      {
+        auto stored = float( value );
+
+        // The difference is exact, because both values are close
+        if( std::isfinite( value ) )
+          _error = std::max( _error, std::abs( double( stored ) - value ) );
+
+        _floats.push_back( stored );
+      }
+    }
+  }
+  else
+  {
+    // Prefer the fewest decimals that represent every value, so that the
+    // stored values are exact. Otherwise, use the full range.
+    double factor = 0.0;
+
+    for( int decimals = 0; decimals <= maxDecimals && factor == 0.0; decimals++ )
+    {
+      if( representable( timeSeries, std::pow( 10.0, decimals ) ) )
+        factor = std::pow( 10.0, decimals );
+    }
+
+    if( factor == 0.0 )
+      factor = _maxValue > 0.0 ? maxInteger / _maxValue : 1.0;
+
+    _scale = 1.0 / factor;
+    _integers.reserve( _offsets.back() );
+
+    for( auto&& T : timeSeries )
+    {
+      for( auto&& value : T )
+      {
+        if( std::isnan( value ) )
+        {
+          _integers.push_back( missingValue );
+          continue;
+        }
+
+        auto k = std::round( value * factor );
+        k      = std::max( -maxInteger, std::min( maxInteger, k ) );
+
+        // The product of the integer and the scale is subject to one more
+        // rounding, which is covered by the additional term.
+        _error = std::max( _error, std::abs( k * _scale - value ) + std::numeric_limits<double>::epsilon() * _maxValue );
+
+        _integers.push_back( std::int16_t( k ) );
+      }
+    }
+  }
+}
+
+std::size_t CompactStorage::bytes() const noexcept
+{
+  return _floats.size() * sizeof(float) + _integers.size() * sizeof(std::int16_t);
+}
+
+void CompactStorage::distances( const CandidateView& candidate, double* distances ) const
+{
+  assert( candidate.index + 1 < _offsets.size() );
+
+  // The values are converted to double precision once per comparison,
+  // which is exact. The converted time series remains in the cache
+  // while the kernel passes over it many times, so only the stored
+  // values are read from memory.
+  thread_local std::vector<double> pattern;
+  thread_local std::vector<double> sequence;
+
+  std::size_t n = candidate.length;
+  auto begin    = _offsets[ candidate.index ] + candidate.start;
+
+  this->widen( begin, begin + n, pattern );
+
+  for( std::size_t j = 0; j + 1 < _offsets.size(); j++ )
+  {
+    auto m = _offsets[j+1] - _offsets[j];
+
+    this->widen( _offsets[j], _offsets[j+1], sequence );
+
+    // As for `TimeSeries::distance()`, the shorter sequence is the one
+    // that is moved along the longer one.
+    distances[j] = n <= m ? squaredEuclideanDistance( pattern.data(), n, sequence.data(), m )
+                          : squaredEuclideanDistance( sequence.data(), m, pattern.data(), n );
+
+    // Pairs without a single window that lacks missing values keep the
+    // largest distance, as for double precision.
+    if( _precision == Precision::Int16 && distances[j] != std::numeric_limits<double>::max() )
+      distances[j] *= _scale * _scale;
+  }
+}
+
+void CompactStorage::widen( std::size_t begin, std::size_t end, std::vector<double>& values ) const
+{
+  if( _precision == Precision::Float )
+    values.assign( _floats.begin() + long( begin ), _floats.begin() + long( end ) );
+  else
+  {
+    values.resize( end - begin );
+
+    for( std::size_t i = begin; i < end; i++ )
+    {
+      values[ i - begin ] = _integers[i] != missingValue ? double( _integers[i] )
+                                                         : std::numeric_limits<double>::quiet_NaN();
+    }
+  }
+}
+
+double CompactStorage::tolerance( std::size_t n ) const noexcept
+{
+  constexpr double epsilon = std::numeric_limits<double>::epsilon();
+
+  // Every difference of two values changes by at most twice the error of
+  // a stored value, and it is at most twice the maximum value. Hence, its
+  // square changes by at most delta * ( 2 * range + delta ). Both sums are
+  // additionally subject to round-off errors of at most (n+4) epsilon
+  // relative to the sum of all squares.
+  auto range = 2.0 * _maxValue;
+  auto delta = 2.0 * _error;
+  auto N     = double( n );
+
+  return N * delta * ( 2.0 * range + delta ) + 2.0 * ( N + 4.0 ) * epsilon * N * range * range;
+}
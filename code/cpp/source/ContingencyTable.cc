@@ -8,18 +8,10 @@
 #include <cassert>
 #include <cmath>
 
-// Shared probability distribution for all contingency tables. It makes
-// no sense to provide multiple copies here.
-boost::math::chi_squared_distribution<long double> ContingencyTable::_chi2
-  = boost::math::chi_squared_distribution<long double>( 1 );
-
-LookupTable ContingencyTable::_lookupTable
-  = LookupTable( 0, 0);
+#include <boost/math/distributions/chi_squared.hpp>
 
 ContingencyTable::ContingencyTable()
-  : _n ( 0 )
-  , _n1( 0 )
-  , _n0( 0 )
+  : _lookupTable( nullptr )
   , _as( 0 )
   , _bs( 0 )
   , _cs( 0 )
@@ -28,22 +20,32 @@ ContingencyTable::ContingencyTable()
 {
 }
 
-ContingencyTable::ContingencyTable( unsigned n, unsigned n1, double threshold, bool withPseudocounts )
-  : _n ( withPseudocounts ? n  + 4 : n  )
-  , _n1( withPseudocounts ? n1 + 2 : n1 )
-  , _n0( _n - _n1 )
+ContingencyTable::ContingencyTable( unsigned n, unsigned n1, double threshold, bool withPseudocounts, const LookupTable& lookupTable )
+  : _lookupTable( &lookupTable )
   , _as( withPseudocounts ? 1 : 0 )
   , _bs( withPseudocounts ? 1 : 0 )
   , _cs( withPseudocounts ? 1 : 0 )
   , _ds( withPseudocounts ? 1 : 0 )
   , _threshold( threshold )
 {
-  assert( _n >= _n1 );
-  assert( _n >= _n0 );
-  assert( _n == _n0 + _n1 );
+  assert( n >= n1 );
+  assert( _lookupTable->n()  == ( withPseudocounts ? n  + 4 : n  ) );
+  assert( _lookupTable->n1() == ( withPseudocounts ? n1 + 2 : n1 ) );
+
+  (void) n;
+  (void) n1;
+}
 
-  if( _lookupTable.n() != _n && _lookupTable.n1() != _n1 )
-    _lookupTable = LookupTable( _n, _n1 );
+ContingencyTable::ContingencyTable( unsigned as, unsigned bs, unsigned cs, unsigned ds, double threshold, const LookupTable& lookupTable )
+  : _lookupTable( &lookupTable )
+  , _as( as )
+  , _bs( bs )
+  , _cs( cs )
+  , _ds( ds )
+  , _threshold( threshold )
+{
+  assert( _lookupTable->n()  == as + bs + cs + ds );
+  assert( _lookupTable->n1() == as + bs );
 }
 
 void ContingencyTable::insert( double distance, bool label )
@@ -68,8 +70,8 @@ void ContingencyTable::insert( double distance, bool label )
       _cs += 1;
   }
 
-  assert( _as + _bs <= _n1 );
-  assert( _ds + _cs <= _n0 );
+  assert( _as + _bs <= _lookupTable->n1() );
+  assert( _ds + _cs <= _lookupTable->n() - _lookupTable->n1() );
 }
 
 bool ContingencyTable::operator==( const ContingencyTable& other ) const noexcept
@@ -77,11 +79,7 @@ bool ContingencyTable::operator==( const ContingencyTable& other ) const noexcep
   return   _as == other._as
         && _bs == other._bs
         && _cs == other._cs
-        && _ds == other._ds
-        && _n1 == other._n1
-        && _n0 == other._n0
-        && _n  == other._n; // this last check is somewhat superfluous,
-                            // but what the heck, let's do it anyway
+        && _ds == other._ds;
 }
 
 unsigned ContingencyTable::n1() const noexcept
@@ -106,11 +104,28 @@ unsigned ContingencyTable::qs() const noexcept
 
 long double ContingencyTable::p() const
 {
+  // The other marginals of a complete table are fixed, so only as and rs
+  // are required for identifying it.
+  if( this->complete() )
+    return _lookupTable->p( _as, this->rs(), [this] () { return this->calculateP(); } );
+
+  return this->calculateP();
+}
+
+long double ContingencyTable::calculateP() const
+{
+  if( _lookupTable && _lookupTable->test() == Test::Fisher )
+    return _lookupTable->fisher( _as, _bs, _cs, _ds );
+
   long double pval = 0.0;
 
+  // Creating the distribution is cheap, as it only stores the degrees
+  // of freedom.
+  boost::math::chi_squared_distribution<long double> chi2( 1 );
+
   try
   {
-    pval = boost::math::cdf( boost::math::complement( _chi2, this->t() ) );
+    pval = boost::math::cdf( boost::math::complement( chi2, this->t() ) );
   }
   catch( std::domain_error& e)
   {
@@ -127,28 +142,37 @@ long double ContingencyTable::min_attainable_p() const
 
 long double ContingencyTable::min_attainable_p( unsigned rs ) const
 {
-  return _lookupTable[ rs ];
+  return ( *_lookupTable )[ rs ];
 }
 
 long double ContingencyTable::min_optimistic_p() const
 {
-  auto n1 = this->n1(); // marginals (first row)
-  auto n0 = this->n0(); // marginals (second row)
-  auto m1 = _n1 - n1;   // missing objects (y=1)
-  auto m0 = _n0 - n0;   // missing objects (y=0)
+  auto&& lookupTable = *_lookupTable;
 
-  assert( m1 <= _n1 );
-  assert( m0 <= _n0 );
+  auto n1 = this->n1();                                // marginals (first row)
+  auto n0 = this->n0();                                // marginals (second row)
+  auto m1 = lookupTable.n1() - n1;                     // missing objects (y=1)
+  auto m0 = lookupTable.n() - lookupTable.n1() - n0;   // missing objects (y=0)
 
   return std::min(
-    std::min( _lookupTable[ this->rs() + m1 ], _lookupTable[ this->rs() + m0 ] ),
-    _lookupTable[ this->rs() ]
+    std::min( lookupTable[ this->rs() + m1 ], lookupTable[ this->rs() + m0 ] ),
+    lookupTable[ this->rs() ]
   );
 }
 
+long double ContingencyTable::min_reachable_p() const
+{
+  auto m1 = _lookupTable->n1() - this->n1();                     // missing objects (y=1)
+  auto m0 = _lookupTable->n() - _lookupTable->n1() - this->n0(); // missing objects (y=0)
+
+  // Every missing object may end up in the left column of the table, so
+  // all marginals between the current one and this one are reachable.
+  return _lookupTable->min( this->rs(), this->rs() + m1 + m0 );
+}
+
 bool ContingencyTable::complete() const noexcept
 {
-  return _as + _bs + _cs + _ds == _n;
+  return _lookupTable && this->n() == _lookupTable->n();
 }
 
 long double ContingencyTable::t() const
@@ -0,0 +1,85 @@
+#include "ContingencyTableBuilder.hh"
+
+#include <algorithm>
+#include <iterator>
+
+#include <cassert>
+#include <cmath>
+
+ContingencyTableBuilder::ContingencyTableBuilder( unsigned n, unsigned n1, bool withPseudocounts, const LookupTable& lookupTable )
+  : _n( n )
+  , _n1( n1 )
+  , _withPseudocounts( withPseudocounts )
+  , _lookupTable( lookupTable )
+{
+}
+
+std::size_t ContingencyTableBuilder::operator()( std::vector<DistanceLabelPair>& distanceLabelPairs,
+                                                 std::vector<ContingencyTable>& tables,
+                                                 long double p_tarone ) const
+{
+  assert( distanceLabelPairs.size() == _n );
+
+  tables.clear();
+
+  // Missing distances are sorted to the end. They never fall below any
+  // threshold, so they do not yield a table on their own.
+  std::sort( distanceLabelPairs.begin(), distanceLabelPairs.end(),
+    [] ( const DistanceLabelPair& x, const DistanceLabelPair& y )
+    {
+      return x.first < y.first || ( !std::isnan( x.first ) && std::isnan( y.first ) );
+    }
+  );
+
+  auto end = std::partition_point( distanceLabelPairs.begin(), distanceLabelPairs.end(),
+    [] ( const DistanceLabelPair& x )
+    {
+      return !std::isnan( x.first );
+    }
+  );
+
+  unsigned pseudocount = _withPseudocounts ? 1 : 0;
+  unsigned n1          = _lookupTable.n1();
+  unsigned n0          = _lookupTable.n() - n1;
+  unsigned rsMax       = _n + 2 * pseudocount;
+
+  // Number of items with class 1 and class 0 whose distance is less
+  // than or equal to the current threshold, including pseudocounts.
+  unsigned as = pseudocount;
+  unsigned ds = pseudocount;
+
+  std::size_t numPruned = 0;
+
+  for( auto it = distanceLabelPairs.begin(); it != end; )
+  {
+    auto threshold = it->first;
+
+    for( ; it != end && it->first == threshold; ++it )
+    {
+      if( it->second )
+        ++as;
+      else
+        ++ds;
+    }
+
+    auto rs = as + ds;
+
+    if( p_tarone == 0.0 || _lookupTable[rs] <= p_tarone )
+      tables.emplace_back( as, n1 - as, n0 - ds, ds, threshold, _lookupTable );
+    else
+      ++numPruned;
+
+    // All remaining tables have larger marginals. If none of them can
+    // become testable, it is sufficient to count them.
+    if( p_tarone != 0.0 && it != end && _lookupTable.min( rs + 1, rsMax ) > p_tarone )
+    {
+      for( ; it != end; ++it )
+      {
+        if( std::next( it ) == end || std::next( it )->first != it->first )
+          ++numPruned;
+      }
+    }
+  }
+
+  return numPruned;
+}
@@ -5,10 +5,11 @@
 #include <cassert>
 #include <cmath>
 
-ContingencyTables::ContingencyTables( unsigned n, unsigned n1, bool withPseudocounts )
+ContingencyTables::ContingencyTables( unsigned n, unsigned n1, bool withPseudocounts, const LookupTable& lookupTable )
   : _n( n )
   , _n1( n1 )
   , _withPseudocounts( withPseudocounts )
+  , _lookupTable( lookupTable )
 {
 }
 
@@ -17,7 +18,7 @@ void ContingencyTables::insert( double distance, bool label, long double p_taron
   // Search for the table that is supposed to be updated. Tables are
   // kept sorted according to their threshold.
   auto itPosition = std::lower_bound( _tables.begin(), _tables.end(),
-    ContingencyTable( _n, _n1, distance, _withPseudocounts ),
+    ContingencyTable( _n, _n1, distance, _withPseudocounts, _lookupTable ),
     [] ( const ContingencyTable& table1, const ContingencyTable& table2 )
     {
       return table1.threshold() < table2.threshold();
@@ -28,7 +29,7 @@ void ContingencyTables::insert( double distance, bool label, long double p_taron
   // that we have already seen so far.
   if( itPosition == _tables.end() or itPosition->threshold() != distance )
   {
-    ContingencyTable table( _n, _n1, distance, _withPseudocounts );
+    ContingencyTable table( _n, _n1, distance, _withPseudocounts, _lookupTable );
 
     for( auto&& distanceLabelPair : _distanceLabelPairs )
       table.insert( distanceLabelPair.first, distanceLabelPair.second );
@@ -50,8 +51,11 @@ void ContingencyTables::insert( double distance, bool label, long double p_taron
     {
       itTable->insert( distance, label );
 
-      if( itTable->min_optimistic_p() > p_tarone )
+      if( itTable->min_reachable_p() > p_tarone )
+      {
         itTable = _tables.erase( itTable );
+        ++_numPruned;
+      }
       else
         ++itTable;
     }
@@ -105,11 +109,12 @@ std::size_t ContingencyTables::prune( long double p )
     std::remove_if( _tables.begin(), _tables.end(),
       [&p] ( const ContingencyTable& table )
       {
-        return table.min_optimistic_p() > p;
+        return table.min_reachable_p() > p;
       }
     ),
     _tables.end()
   );
 
+  _numPruned += n - this->size();
   return n - this->size();
 }
@@ -0,0 +1,98 @@
+#include "Dataset.hh"
+
+#include <algorithm>
+#include <memory>
+
+
+#if defined(__linux__)
+  #include <sys/mman.h>
+#endif
+
+namespace
+{
+
+// Size of a huge page on most Linux systems; the buffer is aligned to
+// it if huge pages have been requested, which is required for using
+// them at all.
+constexpr std::size_t hugePageSize = std::size_t( 2 ) << 20;
+
+/**
+  Rounds a number of values up such that the subsequent values start at
+  a multiple of the alignment of the dataset.
+*/
+
+std::size_t pad( std::size_t n ) noexcept
+{
+  constexpr std::size_t valuesPerLine = Dataset::alignment / sizeof( Dataset::ValueType );
+  return ( n + valuesPerLine - 1 ) / valuesPerLine * valuesPerLine;
+}
+
+} // end of anonymous namespace
+
+constexpr std::size_t Dataset::alignment;
+
+Dataset::Dataset( const std::vector<TimeSeries>& timeSeries, bool hugePages, bool squaredSums )
+  : _hugePages( hugePages )
+{
+  // Layout ------------------------------------------------------------
+  //
+  // Every time series occupies its values, padded to the alignment, and
+  // then its n+1 cumulative sums, padded again, if they are required.
+
+  std::vector<std::size_t> offsets;
+  offsets.reserve( timeSeries.size() + 1 );
+  offsets.push_back( 0 );
+
+  for( auto&& T : timeSeries )
+    offsets.push_back( offsets.back() + pad( T.length() ) + ( squaredSums ? pad( T.length() + 1 ) : 0 ) );
+
+  auto boundary = _hugePages ? hugePageSize : alignment;
+
+  _bytes  = std::max( std::size_t( 1 ), offsets.back() * sizeof(ValueType) );
+  _bytes  = ( _bytes + boundary - 1 ) / boundary * boundary;
+  _memory = std::unique_ptr<char[]>( new char[ _bytes + boundary ] );
+
+  void* memory      = _memory.get();
+  std::size_t space = _bytes + boundary;
+  std::align( boundary, _bytes, memory, space );
+
+  // This has to happen before the buffer is touched for the first time.
+  // Failures are harmless because the buffer is then backed by regular
+  // pages.
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if( _hugePages )
+    _hugePages = madvise( memory, _bytes, MADV_HUGEPAGE ) == 0;
+#else
+  _hugePages = false;
+#endif
+
+  auto buffer = static_cast<ValueType*>( memory );
+  std::fill( buffer, buffer + _bytes / sizeof(ValueType), 0.0 );
+
+  // Values and sums ---------------------------------------------------
+
+  _timeSeries.reserve( timeSeries.size() );
+
+  for( std::size_t i = 0; i < timeSeries.size(); i++ )
+  {
+    auto&& T    = timeSeries[i];
+    auto n      = T.length();
+    auto values = buffer + offsets[i];
+    auto sums   = squaredSums ? values + pad( n ) : nullptr;
+
+    std::copy( T.begin(), T.end(), values );
+
+    // The sums are calculated in the same order as in the kernels, which
+    // are thus able to use them without changing their results.
+    if( sums )
+    {
+      sums[0] = 0.0;
+      for( std::size_t k = 0; k < n; k++ )
+        sums[k+1] = sums[k] + values[k] * values[k];
+    }
+
+    _timeSeries.push_back( TimeSeries::view( values, n, sums ) );
+    _timeSeries.back().setIndex( T.index() );
+    _timeSeries.back().setStart( T.start() );
+  }
+}
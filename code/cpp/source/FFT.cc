@@ -0,0 +1,154 @@
+#include "FFT.hh"
+
+#include <stdexcept>
+#include <utility>
+
+#include <cassert>
+#include <cmath>
+
+void fft( std::vector< std::complex<double> >& values, bool inverse )
+{
+  auto n = values.size();
+
+  if( n & ( n - 1 ) )
+    throw std::runtime_error( "FFT requires a power of two as its length" );
+
+  if( n < 2 )
+    return;
+
+  // Bit-reversal permutation ------------------------------------------
+
+  for( std::size_t i = 1, j = 0; i < n; i++ )
+  {
+    auto bit = n >> 1;
+    for( ; j & bit; bit >>= 1 )
+      j ^= bit;
+
+    j ^= bit;
+
+    if( i < j )
+      std::swap( values[i], values[j] );
+  }
+
+  // The twiddle factors are calculated directly for every stage instead
+  // of using a recurrence; this keeps the round-off errors small. Since
+  // the transform is typically called repeatedly for the same length, a
+  // per-thread table is kept.
+  thread_local std::vector< std::complex<double> > twiddles;
+
+  if( twiddles.size() != n / 2 )
+  {
+    twiddles.resize( n / 2 );
+
+    const double pi = std::acos( -1.0 );
+    for( std::size_t k = 0; k < n / 2; k++ )
+      twiddles[k] = std::polar( 1.0, -2.0 * pi * double( k ) / double( n ) );
+  }
+
+  // Butterflies -------------------------------------------------------
+  //
+  // The complex arithmetic is spelled out explicitly because the library
+  // multiplication has to handle infinities and NaNs, which makes it far
+  // slower.
+
+  const double sign = inverse ? -1.0 : 1.0;
+
+  // Accessing the values as an array of interleaved real and imaginary
+  // parts is explicitly permitted by the standard.
+  auto data = reinterpret_cast<double*>( values.data() );
+  auto w    = reinterpret_cast<const double*>( twiddles.data() );
+
+  for( std::size_t length = 2; length <= n; length <<= 1 )
+  {
+    auto half   = length >> 1;
+    auto stride = n / length;
+
+    for( std::size_t i = 0; i < n; i += length )
+    {
+      auto u = data + 2 * i;
+      auto v = data + 2 * ( i + half );
+
+      for( std::size_t k = 0; k < half; k++ )
+      {
+        auto wr = w[ 2 * k * stride     ];
+        auto wi = w[ 2 * k * stride + 1 ] * sign;
+
+        auto vr = v[2*k] * wr - v[2*k+1] * wi;
+        auto vi = v[2*k] * wi + v[2*k+1] * wr;
+
+        v[2*k  ] = u[2*k  ] - vr;
+        v[2*k+1] = u[2*k+1] - vi;
+        u[2*k  ] = u[2*k  ] + vr;
+        u[2*k+1] = u[2*k+1] + vi;
+      }
+    }
+  }
+
+  if( inverse )
+  {
+    for( auto&& value : values )
+      value /= double( n );
+  }
+}
+
+std::size_t transformSize( std::size_t m ) noexcept
+{
+  std::size_t size = 1;
+  while( size < m )
+    size <<= 1;
+
+  return size;
+}
+
+void slidingDotProducts( const double* pattern, std::size_t n,
+                         const double* sequence, std::size_t m,
+                         std::vector< std::complex<double> >& workspace,
+                         std::vector<double>& result )
+{
+  assert( n >= 1 );
+  assert( n <= m );
+
+  // A circular convolution of this size suffices because the only
+  // entries we require, i.e. those of the windows that are entirely
+  // contained in the sequence, do not wrap around.
+  auto N = transformSize( m );
+
+  workspace.assign( N, std::complex<double>() );
+
+  // The sequence is stored in the real part, while the *reversed*
+  // pattern is stored in the imaginary part.
+  for( std::size_t i = 0; i < m; i++ )
+    workspace[i].real( sequence[i] );
+
+  for( std::size_t j = 0; j < n; j++ )
+    workspace[j].imag( pattern[n - 1 - j] );
+
+  fft( workspace );
+
+  // Separate both spectra by exploiting their Hermitian symmetry and
+  // multiply them. The product is symmetric in k and N-k, so each pair
+  // of entries is handled at the same time.
+  for( std::size_t k = 0; k <= N / 2; k++ )
+  {
+    auto l  = ( N - k ) & ( N - 1 );
+    auto zk = workspace[k];
+    auto zl = std::conj( workspace[l] );
+
+    // X = (zk + zl) / 2 and Y = (zk - zl) / 2i are the spectra of the
+    // sequence and of the pattern, respectively.
+    auto xr = 0.5 * ( zk.real() + zl.real() );
+    auto xi = 0.5 * ( zk.imag() + zl.imag() );
+    auto yr = 0.5 * ( zk.imag() - zl.imag() );
+    auto yi = 0.5 * ( zl.real() - zk.real() );
+
+    workspace[k] = std::complex<double>( xr * yr - xi * yi, xr * yi + xi * yr );
+    workspace[l] = std::conj( workspace[k] );
+  }
+
+  fft( workspace, true );
+
+  result.resize( m - n + 1 );
+
+  for( std::size_t i = 0; i < result.size(); i++ )
+    result[i] = workspace[i + n - 1].real();
+}
@@ -0,0 +1,90 @@
+#include "Logging.hh"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/trivial.hpp>
+
+#include <boost/log/sinks/sync_frontend.hpp>
+#include <boost/log/sinks/text_ostream_backend.hpp>
+
+#include <boost/log/utility/formatting_ostream.hpp>
+#include <boost/log/utility/setup/common_attributes.hpp>
+
+#include <boost/make_shared.hpp>
+
+#include <boost/shared_ptr.hpp>
+
+#include <iostream>
+
+namespace
+{
+
+// Adds colours to the output of the log. This is based on an example
+// from StackOverflow [1].
+//
+// [1]: https://stackoverflow.com/a/38316911/1396991
+
+void formatLogRecord( boost::log::record_view const& r, boost::log::formatting_ostream& o )
+{
+  namespace logging = boost::log;
+  auto severity     = r[ logging::trivial::severity ];
+
+  if( severity )
+  {
+    switch( severity.get() )
+    {
+    case logging::trivial::info:
+      o << "\033[32m";
+      break;
+    case logging::trivial::warning:
+      o << "\033[33m";
+      break;
+    case logging::trivial::error:
+    case logging::trivial::fatal:
+      o << "\033[31m";
+      break;
+    default:
+      break;
+    }
+  }
+
+  auto timeStamp = logging::extract<boost::posix_time::ptime>("TimeStamp", r);
+
+  o << boost::posix_time::to_simple_string( *timeStamp ) << ": "
+    << r[ logging::expressions::smessage ];
+
+  // Restore the default colour
+  if( severity )
+    o << "\033[0m";
+  // Silence compiler warnings if Boost.Log is not present in the
+  // platform.
+  (void) r;
+  (void) o;
+}
+
+} // anonymous namespace
+
+void setupLogging()
+{
+  namespace logging = boost::log;
+  auto core         = logging::core::get();
+
+  logging::add_common_attributes();
+
+  boost::shared_ptr<logging::sinks::text_ostream_backend> backend
+    = boost::make_shared<logging::sinks::text_ostream_backend>();
+
+  backend->add_stream(
+    boost::shared_ptr<std::ostream>( &std::clog, []( std::ostream* ) {} )
+  );
+
+  backend->auto_flush( true );
+
+  using Sink = logging::sinks::synchronous_sink<logging::sinks::text_ostream_backend>;
+  boost::shared_ptr<Sink> sink( new Sink( backend ) );
+
+  sink->set_formatter( &formatLogRecord );
+  core->add_sink( sink );
+}
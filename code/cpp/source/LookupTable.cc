@@ -1,25 +1,113 @@
 #include "LookupTable.hh"
 
 #include <algorithm>
+#include <stdexcept>
 
-// Shared probability distribution for all lookup tables. It makes no
-// sense to provide multiple copies here.
-boost::math::chi_squared_distribution<long double> LookupTable::_chi2
-  = boost::math::chi_squared_distribution<long double>( 1 );
+#include <cassert>
+#include <cmath>
 
-LookupTable::LookupTable( unsigned n, unsigned n1 )
+#include <boost/math/distributions/chi_squared.hpp>
+
+Test parseTest( const std::string& name )
+{
+  if( name == "chi2" )
+    return Test::ChiSquared;
+  else if( name == "fisher" )
+    return Test::Fisher;
+
+  throw std::runtime_error( "Unknown test '" + name + "'" );
+}
+
+std::string name( Test test )
+{
+  switch( test )
+  {
+  case Test::Fisher:
+    return "fisher";
+  default:
+    return "chi2";
+  }
+}
+
+LookupTable::LookupTable( unsigned n, unsigned n1, Test test )
   : _n ( n  )
   , _n1( n1 )
+  , _test( test )
   // This initialization ensures that queries can access the `_values`
   // vector at positions 0, ..., rs, where rs <= n. In particular, the
   // initialization solves the issue of having *one* missing cell, for
   // the extreme case of rs == n.
   , _values( n > 0 ? n + 1 : n )
+  , _rows( new std::atomic<Entry*>[ n1 + 1 ] )
+{
+  for( unsigned as = 0; as <= _n1; as++ )
+    _rows[as].store( nullptr, std::memory_order_relaxed );
+
+  if( _test == Test::Fisher )
+  {
+    _logFactorials.resize( _n + 1 );
+    _logFactorials[0] = 0.0;
+
+    for( unsigned k = 1; k <= _n; k++ )
+      _logFactorials[k] = _logFactorials[k-1] + std::log( static_cast<long double>( k ) );
+
+    // The probability of a table decreases towards both extremes of the
+    // left column, and a table is the more significant the less probable
+    // it is, so one of the extremes attains the minimum.
+    for( unsigned rs = 0; rs < unsigned( _values.size() ); rs++ )
+    {
+      auto n0   = _n - _n1;
+      auto kMin = rs > n0 ? rs - n0 : 0;
+      auto kMax = std::min( rs, _n1 );
+
+      _values[rs] = std::min( this->fisher( kMin, _n1 - kMin, n0 - rs + kMin, rs - kMin ),
+                              this->fisher( kMax, _n1 - kMax, n0 - rs + kMax, rs - kMax ) );
+    }
+  }
+  else
+    this->setupChiSquared();
+
+  // Plateaus are reported as multiple minima, which is correct albeit
+  // slightly inefficient.
+  for( unsigned rs = 1; rs + 1 < unsigned( _values.size() ); rs++ )
+  {
+    if( _values[rs] <= _values[rs-1] && _values[rs] <= _values[rs+1] )
+      _minima.push_back( rs );
+  }
+}
+
+LookupTable::~LookupTable()
+{
+  for( unsigned as = 0; as <= _n1; as++ )
+    delete[] _rows[as].load( std::memory_order_relaxed );
+}
+
+LookupTable::Entry& LookupTable::entry( unsigned as, unsigned rs ) const
+{
+  auto&& row   = _rows[as];
+  auto entries = row.load( std::memory_order_acquire );
+
+  if( !entries )
+  {
+    std::unique_ptr<Entry[]> newEntries( new Entry[ _n + 1 ] );
+
+    // Another thread may have allocated the row in the meantime, in
+    // which case its entries are used instead.
+    if( row.compare_exchange_strong( entries, newEntries.get(), std::memory_order_acq_rel ) )
+      entries = newEntries.release();
+  }
+
+  return entries[rs];
+}
+
+void LookupTable::setupChiSquared()
 {
   unsigned rs = 0;
 
+  boost::math::chi_squared_distribution<long double> chi2( 1 );
+
   std::transform( _values.begin(), _values.end(), _values.begin(),
-    [&rs, this] ( long double /* value */ )
+    [&rs, &chi2, this] ( long double /* value */ )
     {
       auto na = std::min(_n1, _n - _n1);
       auto nb = std::max(_n1, _n - _n1);
@@ -36,7 +124,75 @@ LookupTable::LookupTable( unsigned n, unsigned n1 )
         x = (_n-1) * nb/static_cast<long double>(na) * (_n - rs)/static_cast<long double>(rs);
 
       ++rs;
-      return boost::math::cdf( boost::math::complement(_chi2, x ) );
+      return boost::math::cdf( boost::math::complement( chi2, x ) );
     }
   );
 }
+
+long double LookupTable::min( unsigned rsMin, unsigned rsMax ) const noexcept
+{
+  auto p = std::min( _values[rsMin], _values[rsMax] );
+
+  auto first = std::upper_bound( _minima.begin(), _minima.end(), rsMin );
+  auto last  = std::lower_bound( first, _minima.end(), rsMax );
+
+  for( auto it = first; it != last; ++it )
+    p = std::min( p, _values[*it] );
+
+  return p;
+}
+
+long double LookupTable::fisher( unsigned as, unsigned bs, unsigned cs, unsigned ds ) const noexcept
+{
+  auto r1 = as + bs; // items of class 1
+  auto r0 = cs + ds; // items of class 0
+  auto rs = as + ds; // items in the left column
+  auto n  = r1 + r0;
+
+  assert( n < _logFactorials.size() );
+
+  auto&& lf = _logFactorials;
+
+  // Logarithm of the hypergeometric probability of the table with the
+  // same marginals and k items of class 1 in the left column
+  auto logP = [&] ( unsigned k )
+  {
+    return lf[r1] - lf[k] - lf[r1 - k]
+         + lf[r0] - lf[rs - k] - lf[r0 - rs + k]
+         + lf[rs] + lf[n - rs] - lf[n];
+  };
+
+  auto kMin = rs > r0 ? rs - r0 : 0;
+  auto kMax = std::min( rs, r1 );
+
+  // Tables are at least as extreme as the given one if they are at most
+  // as probable, up to a small relative tolerance for round-off errors.
+  // Since the distribution is unimodal, they form one tail on either
+  // side, and summing them from the extremes adds the smallest terms
+  // first.
+  auto limit    = logP( as ) + std::log1p( 1e-7L );
+  long double p = 0.0;
+
+  auto k = kMin;
+
+  for( ; k <= kMax; k++ )
+  {
+    auto logp = logP( k );
+    if( logp > limit )
+      break;
+
+    p += std::exp( logp );
+  }
+
+  // The lower tail may already contain all tables
+  for( auto l = kMax + 1; l > k; l-- )
+  {
+    auto logp = logP( l - 1 );
+    if( logp > limit )
+      break;
+
+    p += std::exp( logp );
+  }
+
+  return std::min( p, 1.0L );
+}
@@ -0,0 +1,298 @@
+#include "LowerBounds.hh"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include <cmath>
+
+namespace
+{
+
+// Statistics of the current thread; every call of the cascade adds its
+// counts once at the end.
+thread_local LowerBoundStatistics threadStatistics;
+
+// Minimum number of values per segment of the PAA bound, and maximum
+// number of segments. Fewer, longer segments make the bound cheaper but
+// also looser.
+constexpr std::size_t minSegmentLength = 4;
+constexpr std::size_t maxSegments      = 8;
+
+// The policies below describe how the differences of a pattern and a
+// window are accumulated. `term()` and `combine()` have to match the
+// calculations of the distance functors *exactly*. The bounds, on the
+// other hand, are formulated without any expensive powers: `bound()` is
+// the contribution of w values whose mean absolute difference is delta,
+// and once the bounds of values with a total weight of w exceed
+// `threshold( limit, w )`, their terms are guaranteed to exceed `limit`
+// (by Jensen's inequality).
+
+struct SquaredEuclidean
+{
+  double term( double d ) const noexcept                     { return d * d;            }
+  double combine( double a, double b ) const noexcept        { return a + b;            }
+  double bound( double w, double d ) const noexcept          { return w * d * d;        }
+  double threshold( double limit, double ) const noexcept    { return limit;            }
+};
+
+struct Manhattan
+{
+  double term( double d ) const noexcept                     { return std::abs( d );    }
+  double combine( double a, double b ) const noexcept        { return a + b;            }
+  double bound( double w, double d ) const noexcept          { return w * d;            }
+  double threshold( double limit, double ) const noexcept    { return limit;            }
+};
+
+struct Power
+{
+  double p;
+
+  double term( double d ) const noexcept                     { return std::pow( std::abs( d ), p );   }
+  double combine( double a, double b ) const noexcept        { return a + b;                          }
+  double bound( double w, double d ) const noexcept          { return w * d;                          }
+  double threshold( double limit, double w ) const noexcept  { return w * std::pow( limit / w, 1 / p ); }
+};
+
+struct Chebyshev
+{
+  double term( double d ) const noexcept                     { return std::abs( d );    }
+  double combine( double a, double b ) const noexcept        { return std::max( a, b ); }
+  double bound( double, double d ) const noexcept            { return d;                }
+  double threshold( double limit, double ) const noexcept    { return limit;            }
+};
+
+/**
+  Accumulates a window in its natural order, abandoning it as soon as it
+  exceeds the current best distance. This is the reference calculation
+  that determines the result.
+*/
+
+template <class Policy> double accumulate( const Policy& policy,
+                                           const double* pattern, std::size_t n,
+                                           const double* window,
+                                           double distance ) noexcept
+{
+  double temp = 0.0;
+  for( std::size_t j = 0; j < n; j++ )
+  {
+    temp = policy.combine( temp, policy.term( window[j] - pattern[j] ) );
+
+    if( temp > distance )
+      break;
+  }
+
+  return temp;
+}
+
+template <class Policy> double cascade( const Policy& policy,
+                                        const double* pattern, std::size_t n,
+                                        const double* sequence, std::size_t m )
+{
+  constexpr double epsilon = std::numeric_limits<double>::epsilon();
+
+  thread_local std::vector<std::size_t> order;
+  thread_local std::vector<double> sums;
+  thread_local std::vector<double> absoluteSums;
+  thread_local std::vector<std::size_t> boundaries;
+  thread_local std::vector<double> weights;
+  thread_local std::vector<double> scales;
+  thread_local std::vector<double> means;
+  thread_local std::vector<double> errors;
+
+  // Pattern -----------------------------------------------------------
+
+  double mean = 0.0;
+  for( std::size_t j = 0; j < n; j++ )
+    mean += pattern[j];
+
+  mean /= double( n );
+
+  order.resize( n );
+  std::iota( order.begin(), order.end(), std::size_t( 0 ) );
+
+  std::stable_sort( order.begin(), order.end(),
+    [&] ( std::size_t a, std::size_t b )
+    {
+      return std::abs( pattern[a] - mean ) > std::abs( pattern[b] - mean );
+    }
+  );
+
+  auto numSegments = std::max( std::size_t( 1 ), std::min( maxSegments, n / minSegmentLength ) );
+
+  boundaries.resize( numSegments + 1 );
+  weights.resize( numSegments );
+  scales.resize( numSegments );
+  means.resize( numSegments );
+  errors.resize( numSegments );
+
+  for( std::size_t k = 0; k <= numSegments; k++ )
+    boundaries[k] = k * n / numSegments;
+
+  // Sequence ----------------------------------------------------------
+
+  sums.resize( m + 1 );
+  absoluteSums.resize( m + 1 );
+
+  sums[0]         = 0.0;
+  absoluteSums[0] = 0.0;
+
+  for( std::size_t i = 0; i < m; i++ )
+  {
+    sums[i+1]         = sums[i] + sequence[i];
+    absoluteSums[i+1] = absoluteSums[i] + std::abs( sequence[i] );
+  }
+
+  // The round-off errors of the means are bounded once for every segment
+  // instead of for every offset; they are dominated by the errors of the
+  // cumulative sums of the sequence.
+  for( std::size_t k = 0; k < numSegments; k++ )
+  {
+    double sum      = 0.0;
+    double absolute = 0.0;
+
+    for( std::size_t j = boundaries[k]; j < boundaries[k+1]; j++ )
+    {
+      sum      += pattern[j];
+      absolute += std::abs( pattern[j] );
+    }
+
+    auto w     = double( boundaries[k+1] - boundaries[k] );
+    weights[k] = w;
+    scales[k]  = 1.0 / w;
+    means[k]   = sum / w;
+    errors[k]  = ( double( w + 1 ) * epsilon * absolute + 2.0 * double( m + 2 ) * epsilon * absoluteSums[m] ) / w;
+  }
+
+  // Cascade -----------------------------------------------------------
+  //
+  // The distance of a window is only skipped if a bound exceeds the
+  // current best distance by more than the round-off errors of both the
+  // bound and the reference calculation, which are at most a few units
+  // in the last place per value.
+
+  LowerBoundStatistics statistics;
+
+  auto margin     = 1.0 + 4.0 * double( n + 4 ) * epsilon;
+  double distance = std::numeric_limits<double>::max();
+
+  // Thresholds of the bounds, which only change with the distance
+  double current   = distance;
+  double limit     = std::numeric_limits<double>::infinity();
+  double kimLimit  = limit;
+  double paaLimit  = limit;
+
+  for( std::size_t i = 0; i + n <= m; i++ )
+  {
+    auto window = sequence + i;
+
+    if( distance != current )
+    {
+      current  = distance;
+      limit    = distance * margin;
+      kimLimit = policy.threshold( limit, n > 1 ? 2.0 : 1.0 ) * margin;
+      paaLimit = policy.threshold( limit, double( n ) ) * margin;
+    }
+
+    statistics.numOffsets++;
+
+    // Stage 1: first and last value
+    {
+      auto bound = policy.bound( 1.0, std::abs( window[0] - pattern[0] ) );
+      if( n > 1 )
+        bound = policy.combine( bound, policy.bound( 1.0, std::abs( window[n-1] - pattern[n-1] ) ) );
+
+      if( bound > kimLimit )
+      {
+        statistics.numKim++;
+        continue;
+      }
+    }
+
+    // Stage 2: means of segments
+    {
+      double bound = 0.0;
+      bool reject  = false;
+
+      for( std::size_t k = 0; k < numSegments && !reject; k++ )
+      {
+        auto a     = i + boundaries[k];
+        auto b     = i + boundaries[k+1];
+        auto delta = std::abs( ( sums[b] - sums[a] ) * scales[k] - means[k] );
+
+        bound  = policy.combine( bound, policy.bound( weights[k], std::max( 0.0, delta * ( 1.0 - 4.0 * epsilon ) - errors[k] ) ) );
+        reject = bound > paaLimit;
+      }
+
+      if( reject )
+      {
+        statistics.numPAA++;
+        continue;
+      }
+    }
+
+    // Stage 3: early abandoning in the order of deviations
+    {
+      double bound = 0.0;
+      bool reject  = false;
+
+      for( std::size_t j = 0; j < n && !reject; j++ )
+      {
+        auto k = order[j];
+        bound  = policy.combine( bound, policy.term( window[k] - pattern[k] ) );
+        reject = bound > limit;
+      }
+
+      if( reject )
+      {
+        statistics.numAbandoned++;
+        continue;
+      }
+    }
+
+    distance = std::min( distance, accumulate( policy, pattern, n, window, distance ) );
+
+    // This is the closest possible distance, so we might as well stop
+    // calculating here.
+    if( distance == 0.0 )
+      break;
+  }
+
+  threadStatistics += statistics;
+
+  return distance;
+}
+
+} // end of anonymous namespace
+
+LowerBoundStatistics takeLowerBoundStatistics() noexcept
+{
+  auto statistics  = threadStatistics;
+  threadStatistics = LowerBoundStatistics();
+
+  return statistics;
+}
+
+double cascadeDistance( const double* pattern, std::size_t n,
+                        const double* sequence, std::size_t m,
+                        Norm norm,
+                        double p )
+{
+  if( n == 0 )
+    return 0.0;
+
+  switch( norm )
+  {
+  case Norm::SquaredEuclidean:
+    return cascade( SquaredEuclidean(), pattern, n, sequence, m );
+  case Norm::Manhattan:
+    return cascade( Manhattan(), pattern, n, sequence, m );
+  case Norm::Power:
+    return cascade( Power{ p }, pattern, n, sequence, m );
+  case Norm::Chebyshev:
+    return cascade( Chebyshev(), pattern, n, sequence, m );
+  }
+
+  return 0.0;
+}
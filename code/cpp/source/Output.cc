@@ -0,0 +1,199 @@
+#include "Output.hh"
+
+#include <iomanip>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+
+// Identifies shard files and the version of their format
+const std::string shardMagic = "S3M shard 2";
+
+// Writes a single significant shapelet, whose values are obtained from
+// the time series. The standardization of the values is undone if the
+// parameters require it.
+void writeShapelet( std::ostream& out,
+                    const Parameters& parameters,
+                    const SignificantShapelets::SignificantShapelet& ss,
+                    const std::vector<TimeSeries>& timeSeries )
+{
+  out << "  {\n"
+      << "    \"p_val\": "     << std::setprecision( 32 ) << ss.p                 << ",\n"
+      << "    \"threshold\": " << std::setprecision( 16 ) << ss.table.threshold() << ",\n"
+      << "    \"table\": ["                               << ss.table             << "],\n"
+      << "    \"index\": "                                << ss.index             << ",\n"
+      << "    \"start\": "                                << ss.start             << ",\n"
+      << "    \"shapelet\": [\n"
+      << "      ";
+
+  auto begin = timeSeries[ ss.index ].begin() + ss.start;
+  auto end   = begin + ss.length;
+
+  for( auto it = begin; it != end; ++it )
+  {
+    if( it != begin )
+      out << ",";
+
+    if( parameters.standardize )
+      out << (*it * parameters.sigma) + parameters.mu;
+    else
+      out << *it;
+  }
+
+  out << "    ]\n"
+      << "  }";
+}
+
+}
+
+void writeJSON( std::ostream& out,
+                const Parameters& parameters,
+                long double p_tarone,
+                const std::vector<SignificantShapelets::SignificantShapelet>& shapelets,
+                const std::vector<TimeSeries>& timeSeries )
+{
+  out << std::setprecision( 32 );
+
+  out << "{\n"
+      << "  \"parameters\": {\n"
+      << "    \"min_length\": "  << parameters.minLength << ",\n"
+      << "    \"max_length\": "  << parameters.maxLength << ",\n"
+      << "    \"stride\": "      << parameters.stride    << ",\n"
+      << "    \"standardize\": " << std::boolalpha << parameters.standardize << std::noboolalpha << ",\n";
+
+  // Only add this section if we deviated from the default distance.
+  // We do not want to clutter up the output.
+  if( !parameters.distance.empty() )
+    out << "    \"distance\": " << "\"" << parameters.distance << "\",\n";
+
+  // Ditto for the tolerances of duplicate removal
+  if( parameters.removeDuplicates && ( parameters.rtol != Parameters().rtol || parameters.atol != Parameters().atol ) )
+  {
+    out << "    \"rtol\": " << parameters.rtol << ",\n"
+        << "    \"atol\": " << parameters.atol << ",\n";
+  }
+
+  // Ditto for the test
+  if( parameters.test != "chi2" )
+    out << "    \"test\": " << "\"" << parameters.test << "\",\n";
+
+  // Ditto for the precision
+  if( parameters.precision != "double" )
+    out << "    \"precision\": " << "\"" << parameters.precision << "\",\n";
+
+  out << "    \"p_tarone\": "    << p_tarone << ",\n"
+      << "    \"version\": "     << "\"" << parameters.version << "\"\n"
+      << "  },\n"
+      << "  \"shapelets\": [\n";
+
+  auto end = shapelets.end();
+  if( parameters.keep != 0 && parameters.keep < shapelets.size() )
+    end = shapelets.begin() + parameters.keep;
+
+  for( auto it = shapelets.begin(); it != end; ++it )
+  {
+    if( it != shapelets.begin() )
+      out << ",\n";
+
+    writeShapelet( out, parameters, *it, timeSeries );
+  }
+
+  out << "  ]\n"
+      << "}\n";
+}
+
+void writeShardHeader( std::ostream& out, const Parameters& parameters, unsigned shard, unsigned numShards )
+{
+  // Sufficient for restoring every `double` exactly
+  out << std::setprecision( 17 );
+
+  out << shardMagic << "\n"
+      << "version "           << parameters.version          << "\n"
+      << "shard "             << shard << " " << numShards   << "\n"
+      << "min_length "        << parameters.minLength        << "\n"
+      << "max_length "        << parameters.maxLength        << "\n"
+      << "stride "            << parameters.stride           << "\n"
+      << "keep "              << parameters.keep             << "\n"
+      << "all "               << parameters.allShapelets     << "\n"
+      << "disable_pruning "   << parameters.disablePruning   << "\n"
+      << "merge_tables "      << parameters.mergeTables      << "\n"
+      << "remove_duplicates " << parameters.removeDuplicates << "\n"
+      << "rtol "              << parameters.rtol             << "\n"
+      << "atol "              << parameters.atol             << "\n"
+      << "standardize "       << parameters.standardize      << "\n"
+      << "with_pseudocounts " << parameters.withPseudocounts << "\n"
+      << "mu "                << parameters.mu               << "\n"
+      << "sigma "             << parameters.sigma            << "\n"
+      << "distance "          << parameters.distance         << "\n"
+      << "precision "         << parameters.precision        << "\n"
+      << "test "              << parameters.test             << "\n"
+      << "end\n";
+}
+
+void readShardHeader( std::istream& in, Parameters& parameters, unsigned& shard, unsigned& numShards )
+{
+  std::string line;
+  std::getline( in, line );
+
+  if( line != shardMagic )
+    throw std::runtime_error( "Unable to read shard: invalid header" );
+
+  while( std::getline( in, line ) && line != "end" )
+  {
+    auto position = line.find( ' ' );
+    auto key      = line.substr( 0, position );
+    auto value    = position != std::string::npos ? line.substr( position + 1 ) : std::string();
+
+    std::istringstream converter( value );
+
+    if( key == "version" )
+      parameters.version = value;
+    else if( key == "shard" )
+      converter >> shard >> numShards;
+    else if( key == "min_length" )
+      converter >> parameters.minLength;
+    else if( key == "max_length" )
+      converter >> parameters.maxLength;
+    else if( key == "stride" )
+      converter >> parameters.stride;
+    else if( key == "keep" )
+      converter >> parameters.keep;
+    else if( key == "all" )
+      converter >> parameters.allShapelets;
+    else if( key == "disable_pruning" )
+      converter >> parameters.disablePruning;
+    else if( key == "merge_tables" )
+      converter >> parameters.mergeTables;
+    else if( key == "remove_duplicates" )
+      converter >> parameters.removeDuplicates;
+    else if( key == "rtol" )
+      converter >> parameters.rtol;
+    else if( key == "atol" )
+      converter >> parameters.atol;
+    else if( key == "standardize" )
+      converter >> parameters.standardize;
+    else if( key == "with_pseudocounts" )
+      converter >> parameters.withPseudocounts;
+    else if( key == "mu" )
+      converter >> parameters.mu;
+    else if( key == "sigma" )
+      converter >> parameters.sigma;
+    else if( key == "distance" )
+      parameters.distance = value;
+    else if( key == "precision" )
+      parameters.precision = value;
+    else if( key == "test" )
+      parameters.test = value;
+    else
+      throw std::runtime_error( "Unable to read shard: unknown key '" + key + "'" );
+
+    if( converter.fail() )
+      throw std::runtime_error( "Unable to read shard: invalid value for key '" + key + "'" );
+  }
+
+  if( line != "end" )
+    throw std::runtime_error( "Unable to read shard: unexpected end of header" );
+}
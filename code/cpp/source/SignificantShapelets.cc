@@ -1,24 +1,355 @@
+#include "BatchedDistances.hh"
 #include "ContingencyTable.hh"
-#include "ContingencyTables.hh"
+#include "ContingencyTableBuilder.hh"
+#include "LowerBounds.hh"
 #include "PiecewiseLinearFunction.hh"
 #include "ProgressDisplay.hh"
 #include "SignificantShapelets.hh"
 #include "SlidingWindow.hh"
+#include "SquaredEuclideanDistance.hh"
 #include "Utilities.hh"
 
+#include "distances/DistanceEngine.hh"
+#include "distances/MASS.hh"
 #include "distances/Minkowski.hh"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
 #include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
 #include <vector>
 
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 
 #include <boost/log/trivial.hpp>
 #include <boost/math/special_functions/factorials.hpp>
 
+/**
+  Result of evaluating a single candidate pattern on all time series.
+  The contingency tables have been pruned with the threshold that was
+  valid at the beginning of the evaluation. It may be larger than the
+  threshold that is valid once the evaluation is reduced.
+*/
+
+struct SignificantShapelets::Evaluation
+{
+  std::vector<ContingencyTable> tables; // remaining tables, sorted by their threshold
+  unsigned numHypotheses = 0;           // number of tested patterns
+  std::size_t numPruned  = 0;           // number of pruned tables
+
+  // Offsets that the cascade of lower bounds has examined or rejected
+  // for this candidate; only used by some distances.
+  LowerBoundStatistics lowerBounds;
+
+  // Buffers for the values and the distances of the candidate; they are
+  // only stored here in order to be reused for the next candidate.
+  TimeSeries candidate;
+  std::vector<ValueType> distances;
+  std::vector<ContingencyTableBuilder::DistanceLabelPair> distanceLabelPairs;
+};
+
+/**
+  State of the reduction of all evaluations, following Tarone's method.
+  The thresholds are kept fixed, while the number of thresholds may be
+  read by any worker in order to obtain the current threshold.
+*/
+
+struct SignificantShapelets::Reduction
+{
+  Reduction( unsigned n_, unsigned n1_, bool withPseudocounts, Test test, std::vector<long double>& thresholds_ )
+    : n( n_ )
+    , n1( n1_ )
+    // The lookup table has to account for the pseudocounts in every
+    // cell of a table.
+    , lookupTable( withPseudocounts ? n  + 4 : n,
+                   withPseudocounts ? n1 + 2 : n1,
+                   test )
+    , builder( n, n1, withPseudocounts, lookupTable )
+    , thresholds( thresholds_ )
+  {
+  }
+
+  unsigned n;
+  unsigned n1;
+
+  // The lookup table is owned by the current extraction, so multiple
+  // extractions with different marginals may run at the same time.
+  LookupTable lookupTable;
+  ContingencyTableBuilder builder;
+
+  std::vector<long double> min_attainable_p_values;
+  std::atomic<std::size_t> numThresholds;
+  long double p_tarone = 0.0;
+
+  // Testable shapelets, i.e. the ones whose minimum attainable $p$-value
+  // does not exceed the current threshold, and possibly shapelets that
+  // have become untestable since they were added. The latter ones are
+  // only removed by `compact()`.
+  std::vector<SignificantShapelet> significantShapelets;
+  std::vector<long double>& thresholds;
+
+  // Number of testable shapelets for every level, i.e. for every
+  // threshold, and their sum over all levels below the current number
+  // of thresholds. This permits updating the FWER estimate in constant
+  // time whenever the threshold changes.
+  std::vector<std::size_t> numTestableByLevel;
+  std::size_t numTestable = 0;
+
+  unsigned numHypotheses    = 0;
+  ProgressDisplay* progress = nullptr;
+
+  std::size_t numReduced    = 0; // number of reduced candidates
+  std::size_t numAdjusted   = 0; // number of reduced candidates when the threshold was adjusted for the last time
+  std::size_t numPruned     = 0; // number of pruned tables
+
+  LowerBoundStatistics lowerBounds; // statistics of all evaluations
+
+  /**
+    Returns the current threshold; may be called by any worker. Once all
+    thresholds have been used up, no pattern is testable any more, which
+    is expressed by a threshold of zero.
+  */
+
+  long double current() const noexcept
+  {
+    std::size_t k = numThresholds;
+    return k > 0 ? min_attainable_p_values[ k - 1 ] : 0.0;
+  }
+
+  /** Checks whether all thresholds have been used up */
+  bool exhausted() const noexcept
+  {
+    return numThresholds == 0;
+  }
+
+  /**
+    Returns the level of a minimum attainable $p$-value, i.e. the index
+    of the smallest threshold that is not exceeded by it. A shapelet is
+    testable as long as its level is less than the number of thresholds.
+  */
+
+  std::size_t level( long double p_min ) const noexcept
+  {
+    return std::size_t( std::lower_bound( min_attainable_p_values.begin(),
+                                          min_attainable_p_values.end(),
+                                          p_min ) - min_attainable_p_values.begin() );
+  }
+
+  /** Removes all shapelets that are not testable any more */
+  void compact()
+  {
+    significantShapelets.erase(
+      std::remove_if( significantShapelets.begin(), significantShapelets.end(),
+        [this] ( const SignificantShapelet& ss )
+        {
+          return ss.p > p_tarone;
+        }
+      ),
+      significantShapelets.end()
+    );
+  }
+};
+
+namespace
+{
+
+/**
+  Key of a contingency table for hashing, which packs its cells into
+  two integers. Keys are ordered lexicographically by the cells.
+*/
+
+struct TableKey
+{
+  explicit TableKey( const ContingencyTable& table ) noexcept
+    : ab( std::uint64_t( table.as() ) << 32 | table.bs() )
+    , cd( std::uint64_t( table.cs() ) << 32 | table.ds() )
+  {
+  }
+
+  bool operator==( const TableKey& other ) const noexcept { return ab == other.ab && cd == other.cd; }
+  bool operator< ( const TableKey& other ) const noexcept { return ab != other.ab ? ab < other.ab : cd < other.cd; }
+
+  std::uint64_t ab;
+  std::uint64_t cd;
+};
+
+struct TableKeyHash
+{
+  std::size_t operator()( const TableKey& key ) const noexcept
+  {
+    return std::size_t( key.ab * 0x9e3779b97f4a7c15ull ^ key.cd );
+  }
+};
+
+// Minimum number of untestable shapelets that are kept before removing
+// them; this prevents compacting short lists over and over again.
+constexpr std::size_t minCompaction = 1024;
+
+/**
+  Copies the values of a candidate from its time series into a buffer,
+  which is required by the distance functors. The buffer keeps its
+  storage, so this does not allocate any memory for most candidates.
+*/
+
+const TimeSeries& materialize( const CandidateView& view,
+                               const std::vector<TimeSeries>& timeSeries,
+                               TimeSeries& candidate )
+{
+  auto begin = timeSeries[ view.index ].begin() + long( view.start );
+
+  candidate.assign( begin, begin + long( view.length ) );
+  candidate.setIndex( view.index );
+  candidate.setStart( view.start );
+
+  return candidate;
+}
+
+/**
+  Distance policy for the original squared Euclidean distance, which is
+  used unless a distance functor has been specified. For long time
+  series, the distance profile is cheaper to calculate and yields the
+  same value.
+*/
+
+struct DefaultDistance
+{
+  SignificantShapelets::ValueType operator()( const TimeSeries& candidate, const TimeSeries& T ) const
+  {
+    if( MASSDistance::cheaper( candidate.length(), T.length() ) )
+      return MASSDistance()( candidate, T );
+    else
+      return candidate.distance( T );
+  }
+};
+
+/**
+  Evaluates a set of candidates using a pool of workers and passes the
+  evaluations to a reducer in the order of the candidates. Only a few
+  candidates may be evaluated ahead of the reducer, which bounds both
+  the memory requirements and the time for which a threshold used by a
+  worker is outdated.
+
+  @param numCandidates Number of candidates
+  @param numThreads    Number of workers; if this is less than two, no
+                       threads will be created
+  @param evaluate      Function that evaluates the candidate with the
+                       given index; must not modify any shared state
+  @param reduce        Function that reduces the evaluation of the
+                       candidate with the given index
+*/
+
+template <class Evaluation, class Evaluate, class Reduce> void evaluateInOrder( std::size_t numCandidates, unsigned numThreads, Evaluate evaluate, Reduce reduce )
+{
+  if( numThreads <= 1 )
+  {
+    Evaluation evaluation;
+
+    for( std::size_t i = 0; i < numCandidates; i++ )
+    {
+      evaluate( i, evaluation );
+      reduce( i, evaluation );
+    }
+
+    return;
+  }
+
+  std::size_t window = 16 * std::size_t( numThreads );
+
+  std::vector<Evaluation> evaluations( window );
+  std::vector<bool> ready( window, false );
+
+  std::atomic<std::size_t> next( 0 ); // next candidate to evaluate
+  std::size_t reduced = 0;            // number of reduced candidates
+
+  std::mutex mutex;
+  std::condition_variable evaluated;
+  std::condition_variable freed;
+
+  auto worker = [&] ()
+  {
+    Evaluation evaluation;
+
+    for( std::size_t i = next++; i < numCandidates; i = next++ )
+    {
+      {
+        std::unique_lock<std::mutex> lock( mutex );
+        freed.wait( lock, [&] { return i < reduced + window; } );
+      }
+
+      evaluate( i, evaluation );
+
+      {
+        std::lock_guard<std::mutex> lock( mutex );
+
+        std::swap( evaluations[ i % window ], evaluation );
+        ready[ i % window ] = true;
+      }
+
+      evaluated.notify_all();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for( unsigned t = 0; t < numThreads; t++ )
+    workers.emplace_back( worker );
+
+  Evaluation evaluation;
+
+  for( std::size_t i = 0; i < numCandidates; i++ )
+  {
+    {
+      std::unique_lock<std::mutex> lock( mutex );
+      evaluated.wait( lock, [&] { return ready[ i % window ]; } );
+
+      std::swap( evaluation, evaluations[ i % window ] );
+      ready[ i % window ] = false;
+      reduced             = i + 1;
+    }
+
+    freed.notify_all();
+    reduce( i, evaluation );
+  }
+
+  for( auto&& thread : workers )
+    thread.join();
+}
+
+// Helper functions for reading and writing the binary parts of shard
+// files. Values are stored in the native representation, so a shard
+// file can only be merged on the same platform.
+
+template <class T> void write( std::ostream& out, const T& value )
+{
+  out.write( reinterpret_cast<const char*>( &value ), sizeof(T) );
+}
+
+template <class T> T read( std::istream& in )
+{
+  T value = T();
+  in.read( reinterpret_cast<char*>( &value ), sizeof(T) );
+
+  if( !in )
+    throw std::runtime_error( "Unable to read shard: unexpected end of file" );
+
+  return value;
+}
+
+// Marks the end of the evaluations in a shard file
+const std::uint64_t endOfShard = std::numeric_limits<std::uint64_t>::max();
+
+}
+
 SignificantShapelets::SignificantShapelets( unsigned size, unsigned windowStride )
   : _minWindowSize( size )
   , _maxWindowSize( size )
@@ -46,60 +377,19 @@ std::vector<SignificantShapelets::SignificantShapelet> SignificantShapelets::ope
 
   BOOST_LOG_TRIVIAL(info) << "n = " << n << ", n1 = " << n1;
 
-  auto min_attainable_p_values = SignificantShapelets::min_attainable_p_values( n, n1, _withPseudocounts );
-
-  // Remove thresholds that are larger than the desired significance
-  // threshold. This does not change testability of patterns because
-  // as long as Tarone's threshold is larger than alpha, we are only
-  // adding patterns that may never be significant.
-  while( min_attainable_p_values.back() > _alpha )
-    min_attainable_p_values.pop_back();
-
-  SlidingWindow sw( _minWindowSize,
-                    _maxWindowSize,
-                    _windowStride );
-
-  sw.setRemoveDuplicates( _removeDuplicates );
-
-  if( _removeDuplicates )
-    BOOST_LOG_TRIVIAL(info) << "Performing duplicate removal during sliding window extraction";
-
-  std::vector<TimeSeries> candidates;
-
-  for( std::size_t i = 0; i < timeSeries.size(); i++ )
-  {
-    auto localCandidates = sw( timeSeries[i] );
+  Reduction reduction( n, n1, _withPseudocounts, _test, thresholds );
+  this->setup( reduction );
 
-    // Set the time series the local candidate originates from in order
-    // to simplify post-procssing.
-    for( auto&& localCandidate : localCandidates )
-      localCandidate.setIndex( unsigned(i) );
+  // Discard the statistics of any previous calculations of this thread,
+  // which may evaluate candidates as well.
+  takeLowerBoundStatistics();
 
-    if( not _removeDuplicates )
-      candidates.insert( candidates.end(), localCandidates.begin(), localCandidates.end() );
-    else
-    {
-      // If duplicates are to be removed, we are only allowed to copy
-      // a local candidate for which no *other* time series satisfies
-      // the proxmimity criterion.
-      std::copy_if(
-        localCandidates.begin(), localCandidates.end(),
-        std::back_inserter( candidates ),
-        [&candidates] ( const TimeSeries& localCandidate )
-        {
-          return std::none_of( candidates.begin(), candidates.end(),
-            [&localCandidate] ( const TimeSeries& t )
-            {
-              return t.isClose( localCandidate );
-            }
-          );
-        }
-      );
-    }
-  }
+  auto candidates = this->candidates( timeSeries );
 
   BOOST_LOG_TRIVIAL(info) << "Obtained " << candidates.size() << " candidate shapelets";
 
+  this->setupStorage( timeSeries );
+
   unsigned maxLength = 0;
   for( auto&& ts : timeSeries )
     maxLength = std::max( maxLength, unsigned( ts.length() ) );
@@ -118,13 +408,14 @@ std::vector<SignificantShapelets::SignificantShapelet> SignificantShapelets::ope
   // Here, we iterate over all remaining candidate shapelets, figure out
   // the best split (with respect to the distance measure), and add them
   // to the list of significant shapelets (at least for the time being).
-
-  std::vector<SignificantShapelet> significantShapelets;
-
-  // Initial threshold for Tarone's method. This will be adjusted inside
-  // the main loop.
-  auto p_tarone = min_attainable_p_values.back();
-  thresholds.push_back( p_tarone );
+  //
+  // Candidates are evaluated by one or more workers, while the results
+  // are merged by a single reducer in the order of the candidates. The
+  // reducer is the only place where Tarone's threshold is adjusted, so
+  // the workers may only see a threshold that is slightly too *large*.
+  // This is not a problem: pruning with a larger threshold keeps more
+  // tables, and the reducer ignores the ones that are not testable for
+  // the threshold that is in place during the reduction.
 
   ProgressDisplay progress( candidates.size() );
   progress.addField( "FWER" );
@@ -132,140 +423,781 @@ std::vector<SignificantShapelets::SignificantShapelet> SignificantShapelets::ope
   progress.addField( "No. testable patterns" );
   progress.addField( "No. tested patterns" );
 
-  unsigned numHypotheses = 0;
-
   if( !_quiet )
+  {
+    reduction.progress = &progress;
     progress.draw();
+  }
 
-  for( std::size_t i = 0; i < candidates.size(); i++ )
-  {
-    // Set up contingency tables and update them -----------------------
-    //
-    // This involves iterating over distances in the order in which they
-    // appear and constantly update all contingency tables. Pruning will
-    // be performed so that not all tables will have to be examined.
-    ContingencyTables tables( n, n1, _withPseudocounts );
+  if( _numThreads > 1 )
+    BOOST_LOG_TRIVIAL(info) << "Evaluating candidates using " << _numThreads << " threads";
 
-    bool skip = false;
-    for( std::size_t j = 0; j < timeSeries.size(); j++ )
-    {
-      TimeSeries::ValueType distance = TimeSeries::ValueType();
+  using Clock = std::chrono::steady_clock;
+
+  // Groups of candidates may be evaluated at once because some parts of
+  // their distance calculations can be shared. Candidates of different
+  // lengths that share their start form a prefix family, whose distances
+  // are calculated incrementally; this changes the order of the reduction,
+  // but not the results. Alternatively, batches of candidates of the same
+  // length can be compared to every time series at the same time. Groups
+  // are only possible for the default distance in double precision.
+  //
+  // Batches only pay off for a single length: for multiple lengths, the
+  // prefix families share far more of their calculations.
+  bool useBatches        = _batchCandidates && !_distance && !_storage && _maxWindowSize == _minWindowSize;
+  bool usePrefixFamilies = !useBatches && !_distance && !_storage && _maxWindowSize > _minWindowSize;
 
-      // No special distance functor specified, so we fall back to the
-      // original squared Euclidean distance.
-      if( !_distance )
-        distance = candidates[i].distance( timeSeries[j] );
+  if( _batchCandidates && !useBatches )
+    BOOST_LOG_TRIVIAL(info) << "Not using batches because they only apply to a single candidate length and to the default distance in double precision";
 
-      // Use the client-provided distance functor
-      else
-        distance = _distance->operator()( candidates[i], timeSeries[j] );
+  if( useBatches || usePrefixFamilies )
+  {
+    auto start  = Clock::now();
+    auto groups = useBatches ? this->batches( candidates ) : this->families( candidates );
 
-      if( _disablePruning )
-        tables.insert( distance, labels[j] );
-      else
-        tables.insert( distance, labels[j], p_tarone );
+    BOOST_LOG_TRIVIAL(info) << "Evaluating candidates in " << groups.size() << ( useBatches ? " batches" : " prefix families" );
 
-      // Have to increment number of hypotheses here because the
-      // `ContingencyTables` class is allowed to prune tables on
-      // its own. Hence, the number of candidates afterwards may
-      // be lower in certain cases.
-      numHypotheses++;
+    evaluateInOrder< std::vector<Evaluation> >( groups.size(), _numThreads,
+      [&] ( std::size_t i, std::vector<Evaluation>& evaluations )
+      {
+        this->evaluate( candidates, groups[i], useBatches, timeSeries, labels, reduction, evaluations );
+      },
+      [&] ( std::size_t i, const std::vector<Evaluation>& evaluations )
+      {
+        for( std::size_t k = 0; k < groups[i].size(); k++ )
+          this->reduce( candidates[ groups[i][k] ], evaluations[k], reduction );
+      }
+    );
+
+    BOOST_LOG_TRIVIAL(info) << "Evaluated candidates in " << std::chrono::duration<double>( Clock::now() - start ).count() << "s";
+  }
+  else
+  {
+    auto start = Clock::now();
 
-      if( tables.empty() )
+    evaluateInOrder<Evaluation>( candidates.size(), _numThreads,
+      [&] ( std::size_t i, Evaluation& evaluation )
+      {
+        this->evaluate( candidates[i], timeSeries, labels, reduction, evaluation );
+      },
+      [&] ( std::size_t i, const Evaluation& evaluation )
       {
-        skip = true;
-        break;
+        this->reduce( candidates[i], evaluation, reduction );
       }
+    );
+
+    BOOST_LOG_TRIVIAL(info) << "Evaluated candidates in " << std::chrono::duration<double>( Clock::now() - start ).count() << "s";
+  }
+
+  // The earlier the threshold reaches its final value, the more tables
+  // can be pruned.
+  BOOST_LOG_TRIVIAL(info) << "Tarone's threshold reached its final value after "
+                          << reduction.numAdjusted << " of " << candidates.size() << " candidates; "
+                          << reduction.numPruned << " contingency tables have been pruned";
+
+  if( this->exhausted( reduction ) )
+    BOOST_LOG_TRIVIAL(warning) << "Tarone's threshold has used up all of its levels, so no pattern is testable";
+
+  // Only some distances use the cascade of lower bounds, so there is
+  // nothing to report for the others.
+  {
+    auto&& statistics = reduction.lowerBounds;
+
+    if( statistics.numOffsets > 0 )
+    {
+      BOOST_LOG_TRIVIAL(info) << "Lower bounds rejected " << statistics.numKim << " (LB_Kim) and "
+                              << statistics.numPAA << " (PAA) of " << statistics.numOffsets << " offsets; "
+                              << statistics.numAbandoned << " offsets have been abandoned early";
     }
+  }
+
+  // Restore the order of the candidates, which is used to break ties
+  // in the output. Candidates are generated in the order of their time
+  // series, their length, and their start.
+  if( usePrefixFamilies )
+  {
+    reduction.compact();
 
-    if( !_quiet )
-      ++progress;
+    std::stable_sort( reduction.significantShapelets.begin(), reduction.significantShapelets.end(),
+      [] ( const SignificantShapelet& S, const SignificantShapelet& T )
+      {
+        if( S.index != T.index )
+          return S.index < T.index;
+        else if( S.length != T.length )
+          return S.length < T.length;
+        else
+          return S.start < T.start;
+      }
+    );
+  }
+
+  // Report the lowest threshold according to Tarone. This can be used
+  // to decide upon further corrections, such as Bonferroni.
+  tarone = reduction.p_tarone;
+
+  return this->finalize( reduction, timeSeries );
+}
+
+void SignificantShapelets::operator()( const std::vector<TimeSeries>& timeSeries,
+                                       const std::vector<bool>& labels,
+                                       unsigned shard,
+                                       unsigned numShards,
+                                       std::ostream& out )
+{
+  assert( timeSeries.size() == labels.size() );
+  assert( shard < numShards );
 
-    if( skip )
-      continue;
+  unsigned n  = unsigned( timeSeries.size() );
+  unsigned n1 = unsigned( std::count( labels.begin(), labels.end(), true ) );
+
+  BOOST_LOG_TRIVIAL(info) << "n = " << n << ", n1 = " << n1;
+
+  // The thresholds are not required here, because the shard does not
+  // adjust them, but the reduction still provides the lookup table.
+  std::vector<long double> thresholds;
+
+  Reduction reduction( n, n1, _withPseudocounts, _test, thresholds );
+  this->setup( reduction );
+
+  auto allCandidates = this->candidates( timeSeries );
 
-    bool updated = false;
+  this->setupStorage( timeSeries );
+
+  // Every shard evaluates the candidates whose index is congruent to the
+  // index of the shard. Compared to contiguous slices, this distributes
+  // candidates of different lengths more evenly.
+  std::vector<std::uint64_t> indices;
+  for( std::size_t i = shard; i < allCandidates.size(); i += numShards )
+    indices.push_back( i );
+
+  BOOST_LOG_TRIVIAL(info) << "Evaluating " << indices.size() << " of " << allCandidates.size() << " candidate shapelets in shard " << shard << "/" << numShards;
+
+  write<std::uint32_t>( out, n );
+  write<std::uint32_t>( out, n1 );
+  write<std::uint64_t>( out, allCandidates.size() );
+  write<std::uint32_t>( out, sizeof(long double) );
+
+  // Every shard adjusts Tarone's threshold based on its own candidates.
+  // Since the threshold does not depend on the order of the candidates,
+  // and the shard only sees a subset of all testable tables, its value
+  // is never smaller than the one of the complete extraction. Hence, it
+  // is sufficient to store the tables that are testable for the current
+  // threshold of the shard.
+  ProgressDisplay progress( indices.size() );
+
+  if( !_quiet )
+  {
+    reduction.progress = &progress;
+    progress.draw();
+  }
 
-    for( auto&& table : tables )
+  evaluateInOrder<Evaluation>( indices.size(), _numThreads,
+    [&] ( std::size_t i, Evaluation& evaluation )
     {
-      auto p_min = table.min_attainable_p();
+      this->evaluate( allCandidates[ indices[i] ], timeSeries, labels, reduction, evaluation );
+    },
+    [&] ( std::size_t i, const Evaluation& evaluation )
+    {
+      auto&& candidate = allCandidates[ indices[i] ];
+
+      std::vector<std::size_t> testable;
+
+      for( std::size_t j = 0; j < evaluation.tables.size(); j++ )
+      {
+        if( _reportAllShapelets || evaluation.tables[j].min_attainable_p() <= reduction.p_tarone )
+          testable.push_back( j );
+      }
 
-      // Pattern is testable according to the current threshold set by
-      // Tarone's criterion. Or else the user is crazy and wants us to
-      // report all shapelets regardless of testability.
-      if( p_min <= p_tarone || _reportAllShapelets )
+      this->reduce( candidate, evaluation, reduction );
+
+      if( testable.empty() )
+        return;
+
+      write<std::uint64_t>( out, indices[i] );
+      write<std::uint32_t>( out, candidate.index );
+      write<std::uint32_t>( out, candidate.start );
+      write<std::uint64_t>( out, candidate.length );
+
+      for( unsigned k = 0; k < candidate.length; k++ )
+        write<ValueType>( out, timeSeries[ candidate.index ][ candidate.start + k ] );
+
+      write<std::uint64_t>( out, testable.size() );
+
+      for( auto&& j : testable )
       {
-        significantShapelets.push_back(
-          {
-            candidates[i],
-            p_min,
-            table
-          }
-        );
-
-        // At least one shapelet has been added, so we need to update
-        // our FWER estimate below.
-        updated = true;
+        auto&& table = evaluation.tables[j];
+
+        write<std::uint32_t>( out, table.as() );
+        write<std::uint32_t>( out, table.bs() );
+        write<std::uint32_t>( out, table.cs() );
+        write<std::uint32_t>( out, table.ds() );
+        write<double>( out, table.threshold() );
+        write<long double>( out, table.min_attainable_p() );
       }
     }
+  );
+
+  write<std::uint64_t>( out, endOfShard );
 
-    // If nothing has been changed, i.e. no shapelet has been added to
-    // the list of the most significant ones, we do not have to change
-    // the FWER estimate.
-    if( !updated )
-      continue;
+  if( !out )
+    throw std::runtime_error( "Unable to write shard" );
+}
+
+std::vector<SignificantShapelets::SignificantShapelet> SignificantShapelets::merge(
+  const std::vector<std::istream*>& shards,
+  long double& tarone,
+  std::vector<long double>& thresholds,
+  std::vector<TimeSeries>& timeSeries )
+{
+  if( shards.empty() )
+    throw std::runtime_error( "Unable to merge an empty set of shards" );
+
+  timeSeries.clear();
+
+  unsigned n                  = 0;
+  unsigned n1                 = 0;
+  std::uint64_t numCandidates = 0;
+
+  for( std::size_t i = 0; i < shards.size(); i++ )
+  {
+    auto&& in = *shards[i];
 
-    // If the user desired to see *all* shapelets, even those that are
-    // statistically insignificant, we can continue the iteration.
-    if( _reportAllShapelets )
-      continue;
+    auto n_             = read<std::uint32_t>( in );
+    auto n1_            = read<std::uint32_t>( in );
+    auto numCandidates_ = read<std::uint64_t>( in );
 
-    auto estimateFWER
-      = p_tarone * static_cast<long double>( significantShapelets.size() );
+    if( read<std::uint32_t>( in ) != sizeof(long double) )
+      throw std::runtime_error( "Unable to merge shards that were created on a different platform" );
 
-    // Adjust the testability threshold until the FWER estimate has
-    // been sufficiently decreased.
-    while( estimateFWER > _alpha )
+    if( i == 0 )
     {
-      min_attainable_p_values.pop_back();
-      p_tarone = min_attainable_p_values.back();
-
-      if( !_quiet )
-        progress.setField( "Tarone", p_tarone );
-
-      significantShapelets.erase(
-        std::remove_if( significantShapelets.begin(), significantShapelets.end(),
-          [&p_tarone] ( const SignificantShapelet& ss )
-          {
-            return ss.p > p_tarone;
-          }
-        ),
-        significantShapelets.end()
-      );
+      n             = n_;
+      n1            = n1_;
+      numCandidates = numCandidates_;
+    }
+    else if( n != n_ || n1 != n1_ || numCandidates != numCandidates_ )
+      throw std::runtime_error( "Unable to merge shards that belong to different data sets" );
+  }
+
+  BOOST_LOG_TRIVIAL(info) << "n = " << n << ", n1 = " << n1;
+  BOOST_LOG_TRIVIAL(info) << "Merging " << shards.size() << " shards with a total of " << numCandidates << " candidate shapelets";
+
+  Reduction reduction( n, n1, _withPseudocounts, _test, thresholds );
+  this->setup( reduction );
 
-      estimateFWER
-        = p_tarone * static_cast<long double>( significantShapelets.size() );
+  // Reads the next evaluation from a shard and returns the index of the
+  // candidate, or the end marker if the shard has been exhausted.
+  auto next = [&reduction, &timeSeries] ( std::istream& in, CandidateView& candidate, Evaluation& evaluation )
+  {
+    auto index = read<std::uint64_t>( in );
+    if( index == endOfShard )
+      return index;
+
+    auto parent = read<std::uint32_t>( in );
+    auto start  = read<std::uint32_t>( in );
+    auto length = read<std::uint64_t>( in );
+
+    std::vector<ValueType> values;
+    values.reserve( length );
+
+    for( std::uint64_t i = 0; i < length; i++ )
+      values.push_back( read<ValueType>( in ) );
+
+    candidate.index  = parent;
+    candidate.start  = start;
+    candidate.length = unsigned( length );
+
+    // Restore the part of the time series that the candidate belongs to
+    // in order to be able to report the values of the shapelets.
+    if( timeSeries.size() <= parent )
+      timeSeries.resize( parent + 1 );
+
+    auto&& T = timeSeries[ parent ];
+    if( T.length() < start + length )
+    {
+      std::vector<ValueType> restored( T.begin(), T.end() );
+      restored.resize( start + length, std::numeric_limits<ValueType>::quiet_NaN() );
+
+      T = TimeSeries( restored.begin(), restored.end() );
+    }
+
+    std::copy( values.begin(), values.end(), T.begin() + start );
+
+    evaluation.tables.clear();
+
+    auto numTables = read<std::uint64_t>( in );
+
+    for( std::uint64_t i = 0; i < numTables; i++ )
+    {
+      auto as        = read<std::uint32_t>( in );
+      auto bs        = read<std::uint32_t>( in );
+      auto cs        = read<std::uint32_t>( in );
+      auto ds        = read<std::uint32_t>( in );
+      auto threshold = read<double>( in );
+      auto p_min     = read<long double>( in );
+
+      if( as + bs != reduction.lookupTable.n1() || as + bs + cs + ds != reduction.lookupTable.n() )
+        throw std::runtime_error( "Unable to merge shards: inconsistent contingency table" );
+
+      ContingencyTable table( as, bs, cs, ds, threshold, reduction.lookupTable );
+
+      if( table.min_attainable_p() != p_min )
+        throw std::runtime_error( "Unable to merge shards: inconsistent minimum attainable p-value" );
+
+      evaluation.tables.push_back( table );
+    }
+
+    return index;
+  };
+
+  // Every shard stores its candidates in increasing order, so it is
+  // sufficient to look at the next candidate of every shard in order
+  // to replay the reduction in the order of all candidates.
+  std::vector<std::uint64_t> indices( shards.size() );
+  std::vector<CandidateView> candidates( shards.size() );
+  std::vector<Evaluation> evaluations( shards.size() );
+
+  for( std::size_t i = 0; i < shards.size(); i++ )
+    indices[i] = next( *shards[i], candidates[i], evaluations[i] );
+
+  for( ;; )
+  {
+    auto it = std::min_element( indices.begin(), indices.end() );
+    if( *it == endOfShard )
+      break;
+
+    auto i = std::size_t( std::distance( indices.begin(), it ) );
+
+    this->reduce( candidates[i], evaluations[i], reduction );
+    indices[i] = next( *shards[i], candidates[i], evaluations[i] );
+  }
+
+  tarone = reduction.p_tarone;
+  return this->finalize( reduction, timeSeries );
+}
+
+void SignificantShapelets::setup( Reduction& reduction ) const
+{
+  auto&& min_attainable_p_values = reduction.min_attainable_p_values;
+
+  min_attainable_p_values
+    = SignificantShapelets::min_attainable_p_values( reduction.n,
+                                                     reduction.n1,
+                                                     _withPseudocounts,
+                                                     reduction.lookupTable );
+
+  // Remove thresholds that are larger than the desired significance
+  // threshold. This does not change testability of patterns because
+  // as long as Tarone's threshold is larger than alpha, we are only
+  // adding patterns that may never be significant.
+  //
+  // For very small data sets, no threshold may be left at all, so not a
+  // single pattern is testable.
+  while( !min_attainable_p_values.empty() && min_attainable_p_values.back() > _alpha )
+    min_attainable_p_values.pop_back();
+
+  // Initial threshold for Tarone's method. This will be adjusted by the
+  // reducer. The workers only require the number of thresholds in order
+  // to look up the current one.
+  reduction.numThresholds = min_attainable_p_values.size();
+  reduction.p_tarone      = reduction.current();
+
+  reduction.numTestableByLevel.assign( min_attainable_p_values.size(), 0 );
+
+  reduction.thresholds.push_back( reduction.p_tarone );
+}
+
+Candidates SignificantShapelets::candidates( const std::vector<TimeSeries>& timeSeries ) const
+{
+  SlidingWindow sw( _minWindowSize,
+                    _maxWindowSize,
+                    _windowStride );
+
+  sw.setRemoveDuplicates( _removeDuplicates );
+  sw.setTolerances( _rtol, _atol );
+
+  if( _removeDuplicates )
+    BOOST_LOG_TRIVIAL(info) << "Performing duplicate removal during sliding window extraction";
+
+  return sw( timeSeries );
+}
+
+void SignificantShapelets::setupStorage( const std::vector<TimeSeries>& timeSeries )
+{
+  _storage = nullptr;
+
+  if( _precision == Precision::Double )
+    return;
+
+  if( _distance )
+  {
+    BOOST_LOG_TRIVIAL(warning) << "Ignoring precision " << name( _precision ) << " because it only applies to the default distance";
+    return;
+  }
+
+  _storage = std::make_shared<CompactStorage>( timeSeries, _precision );
+
+  BOOST_LOG_TRIVIAL(info) << "Storing time series as " << name( _precision ) << " in " << _storage->bytes() << " bytes "
+                          << "(scale: " << _storage->scale() << ", maximum error: " << _storage->error() << ")";
+}
+
+SignificantShapelets::ValueType SignificantShapelets::distance( const TimeSeries& candidate, const TimeSeries& T ) const
+{
+  // No special distance functor specified, so we fall back to the
+  // original squared Euclidean distance.
+  if( !_distance )
+    return DefaultDistance()( candidate, T );
+
+  // Use the client-provided distance functor
+  else
+    return _distance->operator()( candidate, T );
+}
+
+void SignificantShapelets::distances( const TimeSeries& candidate,
+                                      const std::vector<TimeSeries>& timeSeries,
+                                      ValueType* distances ) const
+{
+  if( !_distance )
+    calculateDistances( DefaultDistance(), candidate, timeSeries, distances );
+  else
+    _distance->distances( candidate, timeSeries, distances );
+}
+
+void SignificantShapelets::evaluate( const CandidateView& candidate,
+                                     const std::vector<TimeSeries>& timeSeries,
+                                     const std::vector<bool>& labels,
+                                     const Reduction& reduction,
+                                     Evaluation& evaluation ) const
+{
+  auto p_tarone = reduction.current();
+
+  evaluation.numHypotheses = unsigned( timeSeries.size() );
+
+  // Once all thresholds have been used up, no table is able to become
+  // testable any more, so the distances are not required at all.
+  if( this->exhausted( reduction ) )
+  {
+    evaluation.tables.clear();
+    evaluation.numPruned   = 0;
+    evaluation.lowerBounds = LowerBoundStatistics();
+    return;
+  }
+
+  // Set up contingency tables -----------------------------------------
+  //
+  // This involves calculating all distances first and creating the
+  // tables of all thresholds at once afterwards. Pruning will be
+  // performed so that not all tables will have to be examined.
+  auto&& distanceLabelPairs = evaluation.distanceLabelPairs;
+  auto&& distances          = evaluation.distances;
+
+  distances.resize( timeSeries.size() );
+  distanceLabelPairs.clear();
+
+  // Compact storage contains the values of the candidate already
+  if( _storage )
+    _storage->distances( candidate, distances.data() );
+  else
+    this->distances( materialize( candidate, timeSeries, evaluation.candidate ), timeSeries, distances.data() );
+
+  // The statistics are kept by every thread, so they are collected here
+  // and summed up by the reducer.
+  evaluation.lowerBounds = takeLowerBoundStatistics();
+
+  for( std::size_t j = 0; j < timeSeries.size(); j++ )
+    distanceLabelPairs.emplace_back( distances[j], labels[j] );
+
+  evaluation.numPruned     = reduction.builder( distanceLabelPairs,
+                                                evaluation.tables,
+                                                _disablePruning ? 0.0 : p_tarone );
+}
+
+std::vector< std::vector<std::size_t> > SignificantShapelets::families( const Candidates& candidates ) const
+{
+  // Candidates are generated in the order of their time series, their
+  // length, and their start, so every family is sorted by length.
+  std::map< std::pair<unsigned, unsigned>, std::vector<std::size_t> > families;
+
+  for( std::size_t i = 0; i < candidates.size(); i++ )
+  {
+    auto candidate = candidates[i];
+    families[ std::make_pair( candidate.index, candidate.start ) ].push_back( i );
+  }
+
+  std::vector< std::vector<std::size_t> > result;
+  result.reserve( families.size() );
+
+  for( auto&& family : families )
+    result.emplace_back( std::move( family.second ) );
+
+  return result;
+}
+
+std::vector< std::vector<std::size_t> > SignificantShapelets::batches( const Candidates& candidates ) const
+{
+  std::vector< std::vector<std::size_t> > result;
+
+  CandidateView previous;
+
+  for( std::size_t i = 0; i < candidates.size(); i++ )
+  {
+    auto candidate = candidates[i];
+
+    bool extend = !result.empty()
+               && result.back().size() < _batchSize
+               && previous.index  == candidate.index
+               && previous.length == candidate.length;
+
+    if( !extend )
+      result.emplace_back();
+
+    result.back().push_back( i );
+    previous = candidate;
+  }
+
+  return result;
+}
+
+void SignificantShapelets::evaluate( const Candidates& candidates,
+                                     const std::vector<std::size_t>& group,
+                                     bool isBatch,
+                                     const std::vector<TimeSeries>& timeSeries,
+                                     const std::vector<bool>& labels,
+                                     const Reduction& reduction,
+                                     std::vector<Evaluation>& evaluations ) const
+{
+  assert( !group.empty() );
+
+  auto p_tarone = reduction.current();
+
+  evaluations.resize( group.size() );
+
+  for( auto&& evaluation : evaluations )
+  {
+    evaluation.numHypotheses = unsigned( timeSeries.size() );
+    evaluation.numPruned     = 0;
+    evaluation.lowerBounds   = LowerBoundStatistics();
+
+    evaluation.tables.clear();
+    evaluation.distanceLabelPairs.clear();
+  }
+
+  if( this->exhausted( reduction ) )
+    return;
+
+  if( isBatch )
+  {
+    auto first = candidates[ group.front() ];
+
+    // Candidates of a batch are consecutive windows of their time series
+    // unless a stride or duplicate removal leaves gaps between them. The
+    // dot products of consecutive windows can be updated from each other.
+    bool consecutive = first.index < timeSeries.size();
+
+    for( std::size_t k = 1; k < group.size() && consecutive; k++ )
+      consecutive = candidates[ group[k] ].start == first.start + k;
+
+    std::vector<ValueType> distances;
+
+    if( consecutive && slidingDistancesCheaper( first.length ) )
+    {
+      slidingDistances( timeSeries[ first.index ],
+                        first.start,
+                        first.length,
+                        group.size(),
+                        timeSeries,
+                        distances );
+    }
+    else
+    {
+      std::vector<const TimeSeries*> batch;
+      batch.reserve( group.size() );
+
+      for( std::size_t k = 0; k < group.size(); k++ )
+        batch.push_back( &materialize( candidates[ group[k] ], timeSeries, evaluations[k].candidate ) );
+
+      batchedDistances( batch, timeSeries, distances );
+    }
+
+    for( std::size_t k = 0; k < group.size(); k++ )
+    {
+      for( std::size_t j = 0; j < timeSeries.size(); j++ )
+        evaluations[k].distanceLabelPairs.emplace_back( distances[ k * timeSeries.size() + j ], labels[j] );
+    }
+  }
+  else
+  {
+    // All candidates of a prefix family are prefixes of the longest one,
+    // whose values are read directly from its time series.
+    auto longest   = candidates[ group.back() ];
+    auto pattern   = timeSeries[ longest.index ].data() + longest.start;
+    std::size_t minLength = candidates[ group.front() ].length;
+    std::size_t maxLength = longest.length;
+
+    std::vector<ValueType> distances( maxLength - minLength + 1 );
+
+    for( std::size_t j = 0; j < timeSeries.size(); j++ )
+    {
+      auto&& T = timeSeries[j];
 
-      thresholds.push_back( p_tarone );
+      // Candidates that are longer than the time series are handled by the
+      // regular distance calculation, which exchanges both of them.
+      if( minLength <= T.length() )
+      {
+        squaredEuclideanDistances( pattern,
+                                   minLength,
+                                   std::min( maxLength, T.length() ),
+                                   T.data(),
+                                   T.length(),
+                                   distances.data() );
+      }
+
+      for( std::size_t k = 0; k < group.size(); k++ )
+      {
+        std::size_t length = candidates[ group[k] ].length;
+        auto distance      = length <= T.length() ? distances[ length - minLength ]
+                                                  : squaredEuclideanDistance( T.data(), T.length(), pattern, length );
+
+        evaluations[k].distanceLabelPairs.emplace_back( distance, labels[j] );
+      }
     }
+  }
 
-    if( !_quiet )
+  for( auto&& evaluation : evaluations )
+  {
+    evaluation.numPruned     = reduction.builder( evaluation.distanceLabelPairs,
+                                                  evaluation.tables,
+                                                  _disablePruning ? 0.0 : p_tarone );
+  }
+}
+
+bool SignificantShapelets::exhausted( const Reduction& reduction ) const noexcept
+{
+  // Without any adjustments of the threshold, all tables are required,
+  // even if there has not been a single threshold to begin with.
+  return !_reportAllShapelets && reduction.exhausted();
+}
+
+void SignificantShapelets::reduce( const CandidateView& candidate,
+                                   const Evaluation& evaluation,
+                                   Reduction& reduction ) const
+{
+  auto&& significantShapelets = reduction.significantShapelets;
+  auto&& p_tarone             = reduction.p_tarone;
+  auto&& progress             = reduction.progress;
+
+  reduction.numHypotheses += evaluation.numHypotheses;
+  reduction.numPruned     += evaluation.numPruned;
+  reduction.numReduced    += 1;
+  reduction.lowerBounds   += evaluation.lowerBounds;
+
+  if( progress )
+    ++( *progress );
+
+  bool updated = false;
+
+  // Since the threshold of the worker may be larger than the current
+  // one, some tables may not be testable any more.
+  for( auto&& table : evaluation.tables )
+  {
+    auto p_min = table.min_attainable_p();
+
+    // Pattern is testable according to the current threshold set by
+    // Tarone's criterion. Or else the user is crazy and wants us to
+    // report all shapelets regardless of testability.
+    if( p_min <= p_tarone || _reportAllShapelets )
     {
-      progress.setField( "FWER", estimateFWER );
-      progress.setField( "No. testable patterns", significantShapelets.size() );
-      progress.setField( "No. tested patterns", numHypotheses );
+      // The level is irrelevant if all shapelets are reported, because
+      // the threshold is never adjusted then.
+      if( !_reportAllShapelets )
+      {
+        reduction.numTestableByLevel[ reduction.level( p_min ) ] += 1;
+        reduction.numTestable += 1;
+      }
+
+      significantShapelets.push_back(
+        {
+          candidate.index,
+          candidate.start,
+          candidate.length,
+          p_min,
+          table
+        }
+      );
+
+      // At least one shapelet has been added, so we need to update
+      // our FWER estimate below.
+      updated = true;
     }
   }
 
+  // If nothing has been changed, i.e. no shapelet has been added to
+  // the list of the most significant ones, we do not have to change
+  // the FWER estimate.
+  if( !updated )
+    return;
+
+  // If the user desired to see *all* shapelets, even those that are
+  // statistically insignificant, we can continue the iteration.
+  if( _reportAllShapelets )
+    return;
+
+  auto estimateFWER
+    = p_tarone * static_cast<long double>( reduction.numTestable );
+
+  // Adjust the testability threshold until the FWER estimate has
+  // been sufficiently decreased. Lowering the threshold by one level
+  // only removes the shapelets of that level from the count; they are
+  // removed from the list later on. After the last level, the threshold
+  // is zero, so the estimate is zero as well.
+  while( estimateFWER > _alpha && !reduction.exhausted() )
+  {
+    reduction.numTestable -= reduction.numTestableByLevel[ --reduction.numThresholds ];
+
+    p_tarone = reduction.current();
+
+    if( progress )
+      progress->setField( "Tarone", p_tarone );
+
+    estimateFWER
+      = p_tarone * static_cast<long double>( reduction.numTestable );
+
+    reduction.thresholds.push_back( p_tarone );
+    reduction.numAdjusted = reduction.numReduced;
+  }
+
+  // Untestable shapelets are removed once they make up half of the list,
+  // which keeps the memory requirements bounded while still requiring
+  // only constant time per shapelet.
+  if( significantShapelets.size() > 2 * reduction.numTestable + minCompaction )
+    reduction.compact();
+
+  if( progress )
+  {
+    progress->setField( "FWER", estimateFWER );
+    progress->setField( "No. testable patterns", reduction.numTestable );
+    progress->setField( "No. tested patterns", reduction.numHypotheses );
+  }
+}
+
+std::vector<SignificantShapelets::SignificantShapelet> SignificantShapelets::finalize( Reduction& reduction, const std::vector<TimeSeries>& timeSeries ) const
+{
+  reduction.compact();
+
+  std::vector<SignificantShapelet> shapelets;
+  shapelets.swap( reduction.significantShapelets );
+
   // Replace the minimum attainable $p$-value by an actual $p$-value
   // because we have finished the extraction phase.
   std::transform(
-    significantShapelets.begin(), significantShapelets.end(),
-    significantShapelets.begin(),
+    shapelets.begin(), shapelets.end(),
+    shapelets.begin(),
       [] ( const SignificantShapelet& ss )
       {
         SignificantShapelet ss_new = {
-          ss.shapelet,
+          ss.index,
+          ss.start,
+          ss.length,
           ss.table.p(), // returns the actual $p$-value of the contingency table
           ss.table
         };
@@ -277,20 +1209,16 @@ std::vector<SignificantShapelets::SignificantShapelet> SignificantShapelets::ope
   // Remove the shapelets that are not significant according to  the
   // current Tarone threshold. Also remove shapelets whose $p$-value
   // is NaN.
-  significantShapelets.erase(
-    std::remove_if( significantShapelets.begin(), significantShapelets.end(),
-      [&p_tarone] ( const SignificantShapelet& ss )
+  shapelets.erase(
+    std::remove_if( shapelets.begin(), shapelets.end(),
+      [&reduction] ( const SignificantShapelet& ss )
       {
-        return std::isnan( ss.p ) || ss.p > p_tarone;
+        return std::isnan( ss.p ) || ss.p > reduction.p_tarone;
       }
     ),
-    significantShapelets.end()
+    shapelets.end()
   );
 
-  // Report the lowest threshold according to Tarone. This can be used
-  // to decide upon further corrections, such as Bonferroni.
-  tarone = p_tarone;
-
   // Perform contingency table merging if desired by the user. This
   // reduces the number of significant shapelets that are reported,
   // but also makes it easier to sift through the results.
@@ -298,104 +1226,108 @@ std::vector<SignificantShapelets::SignificantShapelet> SignificantShapelets::ope
   {
     BOOST_LOG_TRIVIAL(info) << "Merging contingency tables";
 
-    // Sort contingency tables in lexicographical order. This makes it
-    // easier to remove duplicates afterwards.
-    std::stable_sort( significantShapelets.begin(), significantShapelets.end(),
-      [] ( const SignificantShapelet& S, const SignificantShapelet& T )
-      {
-        auto as = S.table.as();
-        auto bs = S.table.bs();
-        auto cs = S.table.cs();
-        auto ds = S.table.ds();
-
-        auto at = T.table.as();
-        auto bt = T.table.bs();
-        auto ct = T.table.cs();
-        auto dt = T.table.ds();
-
-        if( as != at )
-          return as < at;
-        else
-        {
-          if( bs != bt )
-            return bs < bt;
-          else
-          {
-            if( cs != ct )
-              return cs < ct;
-            else
-            {
-              if( ds != dt )
-                return ds < dt;
-            }
-          }
-        }
-
-        return false;
-      }
-    );
-
     // Only keep the first contingency table of every 'class' of
     // contingency tables.
-    significantShapelets.erase(
-      std::unique( significantShapelets.begin(), significantShapelets.end(),
-        [] ( const SignificantShapelet& S, const SignificantShapelet& T )
-        {
-          return S.table == T.table;
-        }
-      ),
-      significantShapelets.end()
-    );
+    std::unordered_set<TableKey, TableKeyHash> tables( shapelets.size() );
+
+    std::size_t numKept = 0;
+
+    for( auto&& ss : shapelets )
+    {
+      if( tables.insert( TableKey( ss.table ) ).second )
+        shapelets[ numKept++ ] = ss;
+    }
+
+    shapelets.resize( numKept );
   }
 
   // Sort by increasing $p$-value in order to make the output easier to
-  // parse for humans.
-  std::stable_sort( significantShapelets.begin(), significantShapelets.end(),
-    [] ( const SignificantShapelet& S, const SignificantShapelet& T )
+  // parse for humans. Merged contingency tables are additionally sorted
+  // in lexicographical order, so ties are broken in the same way as in
+  // previous versions, which sorted the tables before merging them.
+  auto mergeTables = _mergeTables;
+
+  std::stable_sort( shapelets.begin(), shapelets.end(),
+    [&mergeTables] ( const SignificantShapelet& S, const SignificantShapelet& T )
     {
       // Sort by $p$-value first...
       if( S.p != T.p )
         return S.p < T.p;
 
       // ...and by length second, in case the $p$-values are equal
-      else
-        return S.shapelet.length() < T.shapelet.length();
+      else if( S.length != T.length || !mergeTables )
+        return S.length < T.length;
+
+      return TableKey( S.table ) < TableKey( T.table );
     }
   );
 
+  // Remove shapelets whose values are equal to the ones of a more
+  // significant shapelet. Shapelets with missing values are never equal
+  // to any other shapelet, so they are always kept.
   {
-    std::vector<SignificantShapelet> significantShapelets_;
+    auto values = [&timeSeries] ( const SignificantShapelet& ss )
+    {
+      return timeSeries[ ss.index ].data() + ss.start;
+    };
 
-    std::copy_if( significantShapelets.begin(), significantShapelets.end(),
-      std::back_inserter( significantShapelets_ ),
-        [&significantShapelets_] ( const SignificantShapelet& ss )
-        {
-          return std::none_of( significantShapelets_.begin(), significantShapelets_.end(),
-            [&ss] ( const SignificantShapelet& tt )
-            {
-              return ss.shapelet == tt.shapelet;
-            }
-          );
-        }
-    );
+    auto hash = [&shapelets, &values] ( std::size_t i )
+    {
+      auto x = values( shapelets[i] );
+
+      std::uint64_t hash = shapelets[i].length;
+
+      for( unsigned j = 0; j < shapelets[i].length; j++ )
+      {
+        // Adding zero turns a negative zero into a positive one, which
+        // are equal but differ in their bits.
+        auto value = x[j] + 0.0;
+
+        std::uint64_t bits = 0;
+        std::memcpy( &bits, &value, sizeof(value) );
 
-    significantShapelets.swap( significantShapelets_ );
+        hash ^= bits + 0x9e3779b97f4a7c15ull + ( hash << 6 ) + ( hash >> 2 );
+      }
+
+      return std::size_t( hash );
+    };
+
+    auto equal = [&shapelets, &values] ( std::size_t i, std::size_t j )
+    {
+      return shapelets[i].length == shapelets[j].length
+          && std::equal( values( shapelets[i] ), values( shapelets[i] ) + shapelets[i].length, values( shapelets[j] ) );
+    };
+
+    std::unordered_set<std::size_t, decltype(hash), decltype(equal)> distinct( shapelets.size(), hash, equal );
+    std::vector<SignificantShapelet> shapelets_;
+
+    for( std::size_t i = 0; i < shapelets.size(); i++ )
+    {
+      auto x       = values( shapelets[i] );
+      bool missing = std::any_of( x, x + shapelets[i].length, [] ( double value ) { return std::isnan( value ); } );
+
+      if( missing || distinct.insert( i ).second )
+        shapelets_.push_back( shapelets[i] );
+    }
+
+    shapelets.swap( shapelets_ );
   }
 
   BOOST_LOG_TRIVIAL(info)
-    << "Detected " << significantShapelets.size()
+    << "Detected " << shapelets.size()
     << " significant shapelet"
-    << ( significantShapelets.size() != 1 ? "s" : "" );
+    << ( shapelets.size() != 1 ? "s" : "" );
 
-  return significantShapelets;
+  return shapelets;
 }
 
-std::vector<long double> SignificantShapelets::min_attainable_p_values( unsigned n, unsigned n1, bool withPseudocounts )
+std::vector<long double> SignificantShapelets::min_attainable_p_values( unsigned n, unsigned n1, bool withPseudocounts, const LookupTable& lookupTable )
 {
   ContingencyTable C( n,
                       n1,
                       0.0,
-                      withPseudocounts ); // use a dummy threshold
+                      withPseudocounts,
+                      lookupTable ); // use a dummy threshold
 
   std::vector<long double> p_values;
   p_values.reserve( n );
@@ -414,27 +1346,13 @@ std::vector<long double> SignificantShapelets::min_attainable_p_values( unsigned
   return p_values;
 }
 
-std::ostream& operator<<( std::ostream& o, const SignificantShapelets::SignificantShapelet& ss )
+TimeSeries SignificantShapelets::SignificantShapelet::shapelet( const std::vector<TimeSeries>& timeSeries ) const
 {
-  o << "  {\n"
-    << "    \"p_val\": "     << std::setprecision( 32 ) << ss.p                 << ",\n"
-    << "    \"threshold\": " << std::setprecision( 16 ) << ss.table.threshold() << ",\n"
-    << "    \"table\": ["                               << ss.table             << "],\n"
-    << "    \"index\": "                                << ss.shapelet.index()  << ",\n"
-    << "    \"start\": "                                << ss.shapelet.start()  << ",\n"
-    << "    \"shapelet\": [\n"
-    << "      ";
-
-  for( auto it = ss.shapelet.begin(); it != ss.shapelet.end(); ++it )
-  {
-    if( it != ss.shapelet.begin() )
-      o << ",";
-
-    o << *it;
-  }
+  auto begin = timeSeries[ index ].begin() + start;
 
-  o << "    ]\n"
-    << "  }";
+  TimeSeries result( begin, begin + length );
+  result.setIndex( index );
+  result.setStart( start );
 
-  return o;
+  return result;
 }
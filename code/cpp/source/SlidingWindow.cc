@@ -2,8 +2,268 @@
 #include "TimeSeries.hh"
 
 #include <algorithm>
+#include <unordered_map>
 
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+
+/**
+  Checks whether two windows of the same length are *close* to each
+  other, following `TimeSeries::isClose()`.
+*/
+
+bool isClose( const CandidateView& S, const CandidateView& T, const std::vector<TimeSeries>& timeSeries, double rtol, double atol )
+{
+  if( S.length != T.length )
+    return false;
+
+  auto x = timeSeries[ S.index ].data() + S.start;
+  auto y = timeSeries[ T.index ].data() + T.start;
+
+  for( unsigned j = 0; j < S.length; j++ )
+  {
+    if( std::abs( x[j] - y[j] ) > ( atol + rtol * std::abs( y[j] ) ) )
+      return false;
+  }
+
+  return true;
+}
+
+/**
+  Index of windows that permits checking whether a window is close to
+  any of them without comparing it to all of them.
+
+  The first, the middle, and the last value of every window are
+  quantized to a grid whose cells are at least twice as wide as the
+  largest tolerance of any value. Two close windows thus lie in the same
+  or in neighbouring cells in every key coordinate, so only those cells
+  have to be checked exactly, which yields the same result as a full
+  scan. Windows with a non-finite key value are not quantized; they are
+  compared to every query, and queries with a non-finite key value are
+  compared to every window, because `isClose()` treats NaNs as close.
+
+  Without any tolerances, close windows have to agree exactly in their
+  key values, so these values themselves serve as cells. If the grid is
+  too fine in comparison to the values, though, the index falls back to
+  comparing every window.
+*/
+
+class WindowIndex
+{
+public:
+  WindowIndex( const std::vector<TimeSeries>& timeSeries, double rtol, double atol )
+    : _timeSeries( timeSeries )
+    , _rtol( rtol )
+    , _atol( atol )
+  {
+    double maxValue = 0.0;
+
+    for( auto&& T : timeSeries )
+    {
+      for( auto&& value : T )
+      {
+        if( std::isfinite( value ) )
+          maxValue = std::max( maxValue, std::abs( value ) );
+      }
+    }
+
+    // The quotients of close values then differ by at most one half,
+    // plus round-off errors that remain negligible as long as the grid
+    // has a bounded number of cells.
+    _width   = 2.0 * ( atol + rtol * maxValue );
+    _exact   = _width == 0.0;
+    _hashing = _exact || ( std::isfinite( _width ) && maxValue / _width <= maxCells );
+  }
+
+  /** Checks whether the window is close to any window of the index */
+  bool contains( const CandidateView& candidate ) const
+  {
+    auto close = [&] ( const CandidateView& other )
+    {
+      return isClose( other, candidate, _timeSeries, _rtol, _atol );
+    };
+
+    if( std::any_of( _irregular.begin(), _irregular.end(), close ) )
+      return true;
+
+    Cell cell;
+
+    if( !this->quantize( candidate, cell ) )
+    {
+      for( auto&& pair : _cells )
+      {
+        if( std::any_of( pair.second.begin(), pair.second.end(), close ) )
+          return true;
+      }
+
+      return false;
+    }
+
+    // Visit all neighbouring cells; coordinates that are not used by
+    // short windows remain zero.
+    std::int64_t steps[numKeys];
+    for( std::size_t k = 0; k < numKeys; k++ )
+      steps[k] = k < numKeysUsed( candidate.length ) && !_exact ? 1 : 0;
+
+    Cell neighbour = cell;
+
+    for( std::int64_t a = -steps[0]; a <= steps[0]; a++ )
+    {
+      for( std::int64_t b = -steps[1]; b <= steps[1]; b++ )
+      {
+        for( std::int64_t c = -steps[2]; c <= steps[2]; c++ )
+        {
+          neighbour.coordinates[0] = cell.coordinates[0] + a;
+          neighbour.coordinates[1] = cell.coordinates[1] + b;
+          neighbour.coordinates[2] = cell.coordinates[2] + c;
+
+          auto it = _cells.find( neighbour );
+          if( it != _cells.end() && std::any_of( it->second.begin(), it->second.end(), close ) )
+            return true;
+        }
+      }
+    }
+
+    return false;
+  }
+
+  void insert( const CandidateView& candidate )
+  {
+    Cell cell;
+
+    if( this->quantize( candidate, cell ) )
+      _cells[ cell ].push_back( candidate );
+    else
+      _irregular.push_back( candidate );
+  }
+
+  void clear()
+  {
+    _cells.clear();
+    _irregular.clear();
+  }
+
+private:
+
+  // Number of key coordinates of a window and the largest number of grid
+  // cells along any coordinate
+  static constexpr std::size_t numKeys = 3;
+  static constexpr double maxCells     = 1099511627776.0; // 2^40
+
+  struct Cell
+  {
+    unsigned length = 0;
+    std::int64_t coordinates[numKeys] = { 0, 0, 0 };
+
+    bool operator==( const Cell& other ) const noexcept
+    {
+      return length == other.length && std::equal( coordinates, coordinates + numKeys, other.coordinates );
+    }
+  };
+
+  struct CellHash
+  {
+    std::size_t operator()( const Cell& cell ) const noexcept
+    {
+      std::uint64_t hash = cell.length;
+
+      for( auto&& coordinate : cell.coordinates )
+        hash ^= std::uint64_t( coordinate ) + 0x9e3779b97f4a7c15ull + ( hash << 6 ) + ( hash >> 2 );
+
+      return std::size_t( hash );
+    }
+  };
+
+  static std::size_t numKeysUsed( unsigned length ) noexcept
+  {
+    return length < numKeys ? length : numKeys;
+  }
+
+  /**
+    Calculates the cell of a window. Returns false if the window cannot
+    be quantized, i.e. if the index does not use a grid or if any key
+    value is not finite.
+  */
+
+  bool quantize( const CandidateView& candidate, Cell& cell ) const noexcept
+  {
+    if( !_hashing )
+      return false;
+
+    auto x = _timeSeries[ candidate.index ].data() + candidate.start;
+    auto n = candidate.length;
+
+    // First, last, and middle value; windows that are too short use fewer
+    // key coordinates.
+    unsigned positions[numKeys] = { 0, n - 1, n / 2 };
+
+    cell.length = n;
+
+    for( std::size_t k = 0; k < numKeysUsed( n ); k++ )
+    {
+      auto value = x[ positions[k] ];
+
+      if( !std::isfinite( value ) )
+        return false;
+
+      if( _exact )
+      {
+        // Adding zero turns a negative zero into a positive one, which
+        // are equal but differ in their bits.
+        value += 0.0;
+        std::memcpy( &cell.coordinates[k], &value, sizeof(value) );
+      }
+      else
+        cell.coordinates[k] = std::int64_t( std::floor( value / _width ) );
+    }
+
+    return true;
+  }
+
+  const std::vector<TimeSeries>& _timeSeries;
+
+  double _rtol;
+  double _atol;
+  double _width   = 0.0;
+  bool   _exact   = false;
+  bool   _hashing = false;
+
+  std::unordered_map<Cell, std::vector<CandidateView>, CellHash> _cells;
+  std::vector<CandidateView> _irregular;
+};
+
+} // end of anonymous namespace
+
+std::size_t Candidates::size() const noexcept
+{
+  return _explicit ? _views.size() : _offsets.back();
+}
+
+CandidateView Candidates::operator[]( std::size_t index ) const noexcept
+{
+  assert( index < this->size() );
+
+  if( _explicit )
+    return _views[ index ];
+
+  // The block is the last one that starts at or before the index; empty
+  // blocks are skipped because they start at the same index as the next
+  // one.
+  auto it    = std::upper_bound( _offsets.begin(), _offsets.end(), index ) - 1;
+  auto block = std::size_t( it - _offsets.begin() );
+
+  CandidateView view;
+  view.index  = unsigned( block / _numLengths );
+  view.length = unsigned( _minSize + block % _numLengths );
+  view.start  = unsigned( ( index - *it ) * _stride );
+
+  return view;
+}
 
 SlidingWindow::SlidingWindow( unsigned size, unsigned stride )
   : _minSize( size )
@@ -35,49 +295,82 @@ bool SlidingWindow::removeDuplicates() const noexcept
   return _removeDuplicates;
 }
 
-std::vector<TimeSeries> SlidingWindow::operator()( const TimeSeries& T ) const noexcept
+void SlidingWindow::setTolerances( double rtol, double atol )
 {
-  std::vector<TimeSeries> candidates;
+  assert( rtol >= 0.0 );
+  assert( atol >= 0.0 );
 
-  // Required to silence some warnings about the candidate generation
-  // code below.
-  using DifferenceType = typename std::vector<TimeSeries>::difference_type;
-  auto n               = T.length();
+  _rtol = rtol;
+  _atol = atol;
+}
 
-  for( unsigned size = _minSize; size <= _maxSize; size++ )
+Candidates SlidingWindow::operator()( const std::vector<TimeSeries>& timeSeries ) const
+{
+  Candidates candidates;
+
+  candidates._minSize    = _minSize;
+  candidates._numLengths = _maxSize - _minSize + 1;
+  candidates._stride     = _stride;
+
+  candidates._offsets.reserve( timeSeries.size() * candidates._numLengths + 1 );
+
+  for( auto&& T : timeSeries )
   {
-    for( decltype(n) i = 0; i < n; i += _stride )
+    auto n = T.length();
+
+    for( unsigned size = _minSize; size <= _maxSize; size++ )
     {
-      // No valid pattern
-      if( i + size > T.length() )
-        break;
-
-      TimeSeries candidate
-        = TimeSeries( T.begin() + DifferenceType(i),
-                      T.begin() + DifferenceType(i + size ) );
-
-      candidate.setStart( unsigned(i) );
-
-      // Create a new predicate for closeness detection. If any other
-      // time series satisfies this predicate, the new candidate will
-      // not be added.
-      //
-      // TODO: make the parameters configurable here
-      auto isClose = [&candidate] ( const TimeSeries& t )
-      {
-        return t.isClose( candidate );
-      };
+      std::size_t numWindows = size <= n ? ( n - size ) / _stride + 1 : 0;
+      candidates._offsets.push_back( candidates._offsets.back() + numWindows );
+    }
+  }
+
+  if( not _removeDuplicates )
+    return candidates;
+
+  // Duplicate removal requires all remaining candidates, so they have to
+  // be stored explicitly. This does not copy any values, though.
+  std::vector<CandidateView> local;
+  std::vector<CandidateView> views;
+
+  WindowIndex localIndex( timeSeries, _rtol, _atol );
+  WindowIndex globalIndex( timeSeries, _rtol, _atol );
+
+  std::size_t next = 0;
+
+  for( std::size_t i = 0; i < timeSeries.size(); i++ )
+  {
+    local.clear();
+    localIndex.clear();
+
+    for( ; next < candidates._offsets[ ( i + 1 ) * candidates._numLengths ]; next++ )
+    {
+      auto candidate = candidates[ next ];
 
       // Perform a check for duplicate time series. Notice that this
       // does not use *rounding* but full equality comparisons.
-      if( not _removeDuplicates or std::none_of( candidates.begin(), candidates.end(), isClose ) )
+      if( !localIndex.contains( candidate ) )
       {
-        candidates.emplace_back( candidate );
+        local.push_back( candidate );
+        localIndex.insert( candidate );
+      }
+    }
 
-        assert( candidates.back().length() == size );
+    // If duplicates are to be removed, we are only allowed to keep a
+    // local candidate for which no *other* candidate satisfies the
+    // proximity criterion.
+    for( auto&& candidate : local )
+    {
+      if( !globalIndex.contains( candidate ) )
+      {
+        views.push_back( candidate );
+        globalIndex.insert( candidate );
       }
     }
   }
 
+  candidates._views    = std::move( views );
+  candidates._explicit = true;
+
   return candidates;
 }
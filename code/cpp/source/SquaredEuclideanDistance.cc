@@ -0,0 +1,647 @@
+#include "SquaredEuclideanDistance.hh"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <cassert>
+#include <cmath>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+  #define S3M_X86_KERNELS
+
+  // Some versions of GCC report the undefined pass-through operands of
+  // the masked AVX-512 minimum and maximum as uninitialized.
+  #pragma GCC diagnostic push
+  #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+  #include <immintrin.h>
+  #pragma GCC diagnostic pop
+#endif
+
+// Contracting multiplications and additions to fused operations, which
+// GCC does as soon as a target supports them (AVX-512 does), changes the
+// round-off errors, so the vectorized kernels would not yield the same
+// results as the scalar one any more.
+#if defined(__GNUC__) && !defined(__clang__)
+  #pragma GCC optimize ( "fp-contract=off" )
+#endif
+
+namespace
+{
+
+// Number of values that are accumulated before the vectorized kernels
+// check whether all of their windows can be abandoned.
+constexpr std::size_t blockSize = 8;
+
+// The policies below describe how the differences of a pattern and a
+// window are accumulated, both for scalars and for every vector width.
+// All variants perform the same operations in the same order, so they
+// yield the same results.
+
+struct SquaredDifference
+{
+  static double accumulate( double sum, double x, double y ) noexcept
+  {
+    return sum + (x-y) * (x-y);
+  }
+
+#ifdef S3M_X86_KERNELS
+  __attribute__(( target( "sse2" ) ))
+  static __m128d accumulate( __m128d sum, __m128d x, __m128d y ) noexcept
+  {
+    auto d = _mm_sub_pd( x, y );
+    return _mm_add_pd( sum, _mm_mul_pd( d, d ) );
+  }
+
+  __attribute__(( target( "avx2" ) ))
+  static __m256d accumulate( __m256d sum, __m256d x, __m256d y ) noexcept
+  {
+    auto d = _mm256_sub_pd( x, y );
+    return _mm256_add_pd( sum, _mm256_mul_pd( d, d ) );
+  }
+
+  __attribute__(( target( "avx512f" ) ))
+  static __m512d accumulate( __m512d sum, __m512d x, __m512d y ) noexcept
+  {
+    auto d = _mm512_sub_pd( x, y );
+    return _mm512_add_pd( sum, _mm512_mul_pd( d, d ) );
+  }
+#endif
+};
+
+/**
+  Sum of the P-th powers of the absolute differences, where the powers
+  are calculated by repeated multiplication instead of `std::pow()`.
+*/
+
+template <unsigned P> struct PowerDifference
+{
+  static_assert( P >= 1, "Power must be positive" );
+
+  static double accumulate( double sum, double x, double y ) noexcept
+  {
+    auto d = std::abs( x - y );
+    auto r = d;
+
+    for( unsigned k = 1; k < P; k++ )
+      r = r * d;
+
+    return sum + r;
+  }
+
+#ifdef S3M_X86_KERNELS
+  __attribute__(( target( "sse2" ) ))
+  static __m128d accumulate( __m128d sum, __m128d x, __m128d y ) noexcept
+  {
+    auto d = _mm_andnot_pd( _mm_set1_pd( -0.0 ), _mm_sub_pd( x, y ) );
+    auto r = d;
+
+    for( unsigned k = 1; k < P; k++ )
+      r = _mm_mul_pd( r, d );
+
+    return _mm_add_pd( sum, r );
+  }
+
+  __attribute__(( target( "avx2" ) ))
+  static __m256d accumulate( __m256d sum, __m256d x, __m256d y ) noexcept
+  {
+    auto d = _mm256_andnot_pd( _mm256_set1_pd( -0.0 ), _mm256_sub_pd( x, y ) );
+    auto r = d;
+
+    for( unsigned k = 1; k < P; k++ )
+      r = _mm256_mul_pd( r, d );
+
+    return _mm256_add_pd( sum, r );
+  }
+
+  __attribute__(( target( "avx512f" ) ))
+  static __m512d accumulate( __m512d sum, __m512d x, __m512d y ) noexcept
+  {
+    auto d = _mm512_abs_pd( _mm512_sub_pd( x, y ) );
+    auto r = d;
+
+    for( unsigned k = 1; k < P; k++ )
+      r = _mm512_mul_pd( r, d );
+
+    return _mm512_add_pd( sum, r );
+  }
+#endif
+};
+
+/**
+  Maximum of the absolute differences. A missing value does not change
+  the maximum, which matches `std::max( sum, d )`.
+*/
+
+struct MaximumDifference
+{
+  static double accumulate( double sum, double x, double y ) noexcept
+  {
+    return std::max( sum, std::abs( x - y ) );
+  }
+
+#ifdef S3M_X86_KERNELS
+  __attribute__(( target( "sse2" ) ))
+  static __m128d accumulate( __m128d sum, __m128d x, __m128d y ) noexcept
+  {
+    return _mm_max_pd( _mm_andnot_pd( _mm_set1_pd( -0.0 ), _mm_sub_pd( x, y ) ), sum );
+  }
+
+  __attribute__(( target( "avx2" ) ))
+  static __m256d accumulate( __m256d sum, __m256d x, __m256d y ) noexcept
+  {
+    return _mm256_max_pd( _mm256_andnot_pd( _mm256_set1_pd( -0.0 ), _mm256_sub_pd( x, y ) ), sum );
+  }
+
+  __attribute__(( target( "avx512f" ) ))
+  static __m512d accumulate( __m512d sum, __m512d x, __m512d y ) noexcept
+  {
+    return _mm512_max_pd( _mm512_abs_pd( _mm512_sub_pd( x, y ) ), sum );
+  }
+#endif
+};
+
+/**
+  Scalar kernel, which is also used for the remaining offsets of the
+  vectorized kernels. The current best distance is passed in order to
+  permit early abandoning.
+*/
+
+template <class Difference> double scalarKernel( const double* pattern, std::size_t n,
+                                                 const double* sequence, std::size_t m,
+                                                 double distance ) noexcept
+{
+  for( std::size_t i = 0; i + n <= m; i++ )
+  {
+    double temp = 0.0;
+    for( std::size_t j = 0; j < n; j++ )
+    {
+      temp = Difference::accumulate( temp, sequence[i+j], pattern[j] );
+
+      // Abandon early if we are already worse than the current best
+      // estimate.
+      if( temp > distance )
+        break;
+    }
+
+    distance = std::min( distance, temp );
+
+    // This is the closest possible distance, so we might as well stop
+    // calculating here.
+    if( distance == 0.0 )
+      return distance;
+  }
+
+  return distance;
+}
+
+/**
+  Updates the current best distance with the sums of a set of windows
+  that have *not* been abandoned. Returns true if the closest possible
+  distance has been reached.
+*/
+
+bool update( double& distance, const double* sums, std::size_t numSums ) noexcept
+{
+  for( std::size_t k = 0; k < numSums; k++ )
+  {
+    distance = std::min( distance, sums[k] );
+
+    if( distance == 0.0 )
+      return true;
+  }
+
+  return false;
+}
+
+/**
+  Scalar kernel for the distances of all prefixes of a pattern, starting
+  at a given offset of the sequence. Windows that are too short for the
+  longer prefixes still contribute to the shorter ones. A window is
+  abandoned once its sum exceeds the threshold, i.e. the distance of the
+  longest prefix, since it cannot contribute to any other prefix then.
+*/
+
+void scalarPrefixKernel( const double* pattern, std::size_t minLength, std::size_t maxLength,
+                         const double* sequence, std::size_t m,
+                         std::size_t offset,
+                         double threshold,
+                         double* distances ) noexcept
+{
+  for( std::size_t i = offset; i + minLength <= m; i++ )
+  {
+    auto n = std::min( maxLength, m - i );
+
+    double temp = 0.0;
+    for( std::size_t j = 0; j < n; j++ )
+    {
+      auto x = sequence[i+j];
+      auto y = pattern[  j];
+
+      temp += (x-y) * (x-y);
+
+      if( j + 1 >= minLength )
+        distances[j + 1 - minLength] = std::min( distances[j + 1 - minLength], temp );
+
+      if( temp > threshold )
+        break;
+    }
+  }
+}
+
+#ifdef S3M_X86_KERNELS
+
+// The vectorized kernels below all follow the same scheme: every lane
+// accumulates the sum of one window, and a set of windows is abandoned
+// only if all of its sums exceed the current best distance.
+
+template <class Difference> __attribute__(( target( "sse2" ) ))
+double sse2Kernel( const double* pattern, std::size_t n,
+                   const double* sequence, std::size_t m ) noexcept
+{
+  double distance  = std::numeric_limits<double>::max();
+  auto numOffsets  = m - n + 1;
+  std::size_t i    = 0;
+
+  for( ; i + 2 <= numOffsets; i += 2 )
+  {
+    auto threshold = _mm_set1_pd( distance );
+    auto sum       = _mm_setzero_pd();
+    bool abandoned = false;
+
+    for( std::size_t j = 0; j < n && !abandoned; j += blockSize )
+    {
+      auto end = std::min( n, j + blockSize );
+      for( std::size_t k = j; k < end; k++ )
+      {
+        sum = Difference::accumulate( sum, _mm_loadu_pd( sequence + i + k ), _mm_set1_pd( pattern[k] ) );
+      }
+
+      abandoned = _mm_movemask_pd( _mm_cmpgt_pd( sum, threshold ) ) == 0x3;
+    }
+
+    if( abandoned )
+      continue;
+
+    alignas(16) double sums[2];
+    _mm_store_pd( sums, sum );
+
+    if( update( distance, sums, 2 ) )
+      return distance;
+  }
+
+  return scalarKernel<Difference>( pattern, n, sequence + i, m - i, distance );
+}
+
+template <class Difference> __attribute__(( target( "avx2" ) ))
+double avx2Kernel( const double* pattern, std::size_t n,
+                   const double* sequence, std::size_t m ) noexcept
+{
+  double distance  = std::numeric_limits<double>::max();
+  auto numOffsets  = m - n + 1;
+  std::size_t i    = 0;
+
+  for( ; i + 4 <= numOffsets; i += 4 )
+  {
+    auto threshold = _mm256_set1_pd( distance );
+    auto sum       = _mm256_setzero_pd();
+    bool abandoned = false;
+
+    for( std::size_t j = 0; j < n && !abandoned; j += blockSize )
+    {
+      auto end = std::min( n, j + blockSize );
+      for( std::size_t k = j; k < end; k++ )
+      {
+        sum = Difference::accumulate( sum, _mm256_loadu_pd( sequence + i + k ), _mm256_set1_pd( pattern[k] ) );
+      }
+
+      abandoned = _mm256_movemask_pd( _mm256_cmp_pd( sum, threshold, _CMP_GT_OQ ) ) == 0xF;
+    }
+
+    if( abandoned )
+      continue;
+
+    alignas(32) double sums[4];
+    _mm256_store_pd( sums, sum );
+
+    if( update( distance, sums, 4 ) )
+      return distance;
+  }
+
+  return scalarKernel<Difference>( pattern, n, sequence + i, m - i, distance );
+}
+
+template <class Difference> __attribute__(( target( "avx512f" ) ))
+double avx512Kernel( const double* pattern, std::size_t n,
+                     const double* sequence, std::size_t m ) noexcept
+{
+  double distance  = std::numeric_limits<double>::max();
+  auto numOffsets  = m - n + 1;
+  std::size_t i    = 0;
+
+  for( ; i + 8 <= numOffsets; i += 8 )
+  {
+    auto threshold = _mm512_set1_pd( distance );
+    auto sum       = _mm512_setzero_pd();
+    bool abandoned = false;
+
+    for( std::size_t j = 0; j < n && !abandoned; j += blockSize )
+    {
+      auto end = std::min( n, j + blockSize );
+      for( std::size_t k = j; k < end; k++ )
+      {
+        sum = Difference::accumulate( sum, _mm512_loadu_pd( sequence + i + k ), _mm512_set1_pd( pattern[k] ) );
+      }
+
+      abandoned = _mm512_cmp_pd_mask( sum, threshold, _CMP_GT_OQ ) == 0xFF;
+    }
+
+    if( abandoned )
+      continue;
+
+    alignas(64) double sums[8];
+    _mm512_store_pd( sums, sum );
+
+    if( update( distance, sums, 8 ) )
+      return distance;
+  }
+
+  return scalarKernel<Difference>( pattern, n, sequence + i, m - i, distance );
+}
+
+// The vectorized prefix kernels below process all offsets for which the
+// longest prefix fits into the sequence, in sets of 2, 4, or 8 windows.
+// Their minima are kept per prefix length and per lane. The function
+// returns the first offset that has not been processed.
+
+__attribute__(( target( "sse2" ) ))
+std::size_t sse2PrefixKernel( const double* pattern, std::size_t minLength, std::size_t maxLength,
+                              const double* sequence, std::size_t m,
+                              double threshold,
+                              double* minima ) noexcept
+{
+  auto limit      = _mm_set1_pd( threshold );
+  auto numOffsets = m - maxLength + 1;
+  std::size_t i   = 0;
+
+  for( ; i + 2 <= numOffsets; i += 2 )
+  {
+    auto sum = _mm_setzero_pd();
+
+    for( std::size_t j = 0; j < maxLength; j++ )
+    {
+      auto d = _mm_sub_pd( _mm_loadu_pd( sequence + i + j ), _mm_set1_pd( pattern[j] ) );
+      sum    = _mm_add_pd( sum, _mm_mul_pd( d, d ) );
+
+      // The second operand is returned for NaNs, so they are ignored,
+      // just like in the scalar kernel.
+      if( j + 1 >= minLength )
+      {
+        auto minimum = minima + 2 * ( j + 1 - minLength );
+        _mm_storeu_pd( minimum, _mm_min_pd( sum, _mm_loadu_pd( minimum ) ) );
+      }
+
+      if( ( j + 1 ) % blockSize == 0 && _mm_movemask_pd( _mm_cmpgt_pd( sum, limit ) ) == 0x3 )
+        break;
+    }
+  }
+
+  return i;
+}
+
+__attribute__(( target( "avx2" ) ))
+std::size_t avx2PrefixKernel( const double* pattern, std::size_t minLength, std::size_t maxLength,
+                              const double* sequence, std::size_t m,
+                              double threshold,
+                              double* minima ) noexcept
+{
+  auto limit      = _mm256_set1_pd( threshold );
+  auto numOffsets = m - maxLength + 1;
+  std::size_t i   = 0;
+
+  for( ; i + 4 <= numOffsets; i += 4 )
+  {
+    auto sum = _mm256_setzero_pd();
+
+    for( std::size_t j = 0; j < maxLength; j++ )
+    {
+      auto d = _mm256_sub_pd( _mm256_loadu_pd( sequence + i + j ), _mm256_set1_pd( pattern[j] ) );
+      sum    = _mm256_add_pd( sum, _mm256_mul_pd( d, d ) );
+
+      if( j + 1 >= minLength )
+      {
+        auto minimum = minima + 4 * ( j + 1 - minLength );
+        _mm256_storeu_pd( minimum, _mm256_min_pd( sum, _mm256_loadu_pd( minimum ) ) );
+      }
+
+      if( ( j + 1 ) % blockSize == 0 && _mm256_movemask_pd( _mm256_cmp_pd( sum, limit, _CMP_GT_OQ ) ) == 0xF )
+        break;
+    }
+  }
+
+  return i;
+}
+
+__attribute__(( target( "avx512f" ) ))
+std::size_t avx512PrefixKernel( const double* pattern, std::size_t minLength, std::size_t maxLength,
+                                const double* sequence, std::size_t m,
+                                double threshold,
+                                double* minima ) noexcept
+{
+  auto limit      = _mm512_set1_pd( threshold );
+  auto numOffsets = m - maxLength + 1;
+  std::size_t i   = 0;
+
+  for( ; i + 8 <= numOffsets; i += 8 )
+  {
+    auto sum = _mm512_setzero_pd();
+
+    for( std::size_t j = 0; j < maxLength; j++ )
+    {
+      auto d = _mm512_sub_pd( _mm512_loadu_pd( sequence + i + j ), _mm512_set1_pd( pattern[j] ) );
+      sum    = _mm512_add_pd( sum, _mm512_mul_pd( d, d ) );
+
+      if( j + 1 >= minLength )
+      {
+        auto minimum = minima + 8 * ( j + 1 - minLength );
+        _mm512_storeu_pd( minimum, _mm512_min_pd( sum, _mm512_loadu_pd( minimum ) ) );
+      }
+
+      if( ( j + 1 ) % blockSize == 0 && _mm512_cmp_pd_mask( sum, limit, _CMP_GT_OQ ) == 0xFF )
+        break;
+    }
+  }
+
+  return i;
+}
+
+#endif
+
+/**
+  Selects the kernel of the given instruction set for a policy. This is
+  the only place where the dispatch happens.
+*/
+
+template <class Difference> double distance( const double* pattern, std::size_t n,
+                                             const double* sequence, std::size_t m,
+                                             InstructionSet instructionSet ) noexcept
+{
+  if( n == 0 )
+    return 0.0;
+
+#ifdef S3M_X86_KERNELS
+  switch( instructionSet )
+  {
+  case InstructionSet::AVX512:
+    return avx512Kernel<Difference>( pattern, n, sequence, m );
+  case InstructionSet::AVX2:
+    return avx2Kernel<Difference>( pattern, n, sequence, m );
+  case InstructionSet::SSE2:
+    return sse2Kernel<Difference>( pattern, n, sequence, m );
+  default:
+    break;
+  }
+#else
+  (void) instructionSet;
+#endif
+
+  return scalarKernel<Difference>( pattern, n, sequence, m, std::numeric_limits<double>::max() );
+}
+
+} // end of anonymous namespace
+
+InstructionSet detectInstructionSet() noexcept
+{
+  static const InstructionSet instructionSet = [] ()
+  {
+#ifdef S3M_X86_KERNELS
+    __builtin_cpu_init();
+
+    if( __builtin_cpu_supports( "avx512f" ) )
+      return InstructionSet::AVX512;
+    else if( __builtin_cpu_supports( "avx2" ) )
+      return InstructionSet::AVX2;
+    else if( __builtin_cpu_supports( "sse2" ) )
+      return InstructionSet::SSE2;
+#endif
+
+    return InstructionSet::Scalar;
+  }();
+
+  return instructionSet;
+}
+
+std::string name( InstructionSet instructionSet )
+{
+  switch( instructionSet )
+  {
+  case InstructionSet::SSE2:
+    return "SSE2";
+  case InstructionSet::AVX2:
+    return "AVX2";
+  case InstructionSet::AVX512:
+    return "AVX-512";
+  default:
+    return "scalar";
+  }
+}
+
+double squaredEuclideanDistance( const double* pattern, std::size_t n,
+                                 const double* sequence, std::size_t m,
+                                 InstructionSet instructionSet ) noexcept
+{
+  return distance<SquaredDifference>( pattern, n, sequence, m, instructionSet );
+}
+
+double minkowskiDistance( const double* pattern, std::size_t n,
+                          const double* sequence, std::size_t m,
+                          unsigned p,
+                          InstructionSet instructionSet ) noexcept
+{
+  switch( p )
+  {
+  case 0:
+    return distance<MaximumDifference>( pattern, n, sequence, m, instructionSet );
+  case 1:
+    return distance< PowerDifference<1> >( pattern, n, sequence, m, instructionSet );
+  case 2:
+    return distance<SquaredDifference>( pattern, n, sequence, m, instructionSet );
+  case 3:
+    return distance< PowerDifference<3> >( pattern, n, sequence, m, instructionSet );
+  case 4:
+    return distance< PowerDifference<4> >( pattern, n, sequence, m, instructionSet );
+  case 5:
+    return distance< PowerDifference<5> >( pattern, n, sequence, m, instructionSet );
+  case 6:
+    return distance< PowerDifference<6> >( pattern, n, sequence, m, instructionSet );
+  case 7:
+    return distance< PowerDifference<7> >( pattern, n, sequence, m, instructionSet );
+  case 8:
+    return distance< PowerDifference<8> >( pattern, n, sequence, m, instructionSet );
+  }
+
+  assert( p <= maxIntegerPower );
+  return std::numeric_limits<double>::quiet_NaN();
+}
+
+void squaredEuclideanDistances( const double* pattern, std::size_t minLength, std::size_t maxLength,
+                                const double* sequence, std::size_t m,
+                                double* distances,
+                                InstructionSet instructionSet ) noexcept
+{
+  auto numLengths = maxLength - minLength + 1;
+
+  std::fill( distances, distances + numLengths, std::numeric_limits<double>::max() );
+
+  // No window can contribute to any prefix once it is worse than the
+  // distance of the longest prefix, since the distances of the shorter
+  // prefixes are never larger.
+  auto threshold   = squaredEuclideanDistance( pattern, maxLength, sequence, m, instructionSet );
+  std::size_t next = 0;
+
+#ifdef S3M_X86_KERNELS
+  std::size_t numLanes = 0;
+
+  switch( instructionSet )
+  {
+  case InstructionSet::AVX512:
+    numLanes = 8;
+    break;
+  case InstructionSet::AVX2:
+    numLanes = 4;
+    break;
+  case InstructionSet::SSE2:
+    numLanes = 2;
+    break;
+  default:
+    break;
+  }
+
+  if( numLanes != 0 )
+  {
+    thread_local std::vector<double> minima;
+    minima.assign( numLengths * numLanes, std::numeric_limits<double>::max() );
+
+    switch( instructionSet )
+    {
+    case InstructionSet::AVX512:
+      next = avx512PrefixKernel( pattern, minLength, maxLength, sequence, m, threshold, minima.data() );
+      break;
+    case InstructionSet::AVX2:
+      next = avx2PrefixKernel( pattern, minLength, maxLength, sequence, m, threshold, minima.data() );
+      break;
+    default:
+      next = sse2PrefixKernel( pattern, minLength, maxLength, sequence, m, threshold, minima.data() );
+      break;
+    }
+
+    for( std::size_t k = 0; k < numLengths; k++ )
+    {
+      for( std::size_t l = 0; l < numLanes; l++ )
+        distances[k] = std::min( distances[k], minima[ k * numLanes + l ] );
+    }
+  }
+#endif
+
+  scalarPrefixKernel( pattern, minLength, maxLength, sequence, m, next, threshold, distances );
+}
@@ -1,13 +1,85 @@
+#include "SquaredEuclideanDistance.hh"
 #include "TimeSeries.hh"
 #include "Utilities.hh"
 
 #include <algorithm>
 #include <istream>
 #include <limits>
+#include <stdexcept>
 #include <string>
 
 #include <cmath>
 
+TimeSeries TimeSeries::view( ValueType* data, std::size_t n, const ValueType* squaredSums ) noexcept
+{
+  TimeSeries T;
+
+  T._data        = data;
+  T._length      = n;
+  T._squaredSums = squaredSums;
+
+  return T;
+}
+
+TimeSeries::TimeSeries( const TimeSeries& other )
+  : _index( other._index )
+  , _start( other._start )
+  , _values( other._values )
+  , _data( other.isView() ? other._data : _values.data() )
+  , _length( other._length )
+  , _squaredSums( other._squaredSums )
+{
+}
+
+TimeSeries& TimeSeries::operator=( const TimeSeries& other )
+{
+  if( this != &other )
+    *this = TimeSeries( other );
+
+  return *this;
+}
+
+const TimeSeries::ValueType& TimeSeries::at( std::size_t index ) const
+{
+  if( index >= _length )
+    throw std::out_of_range( "Index exceeds length of time series" );
+
+  return _data[ index ];
+}
+
+TimeSeries::ValueType& TimeSeries::at( std::size_t index )
+{
+  if( index >= _length )
+    throw std::out_of_range( "Index exceeds length of time series" );
+
+  return _data[ index ];
+}
+
+void TimeSeries::pop_front()
+{
+  // A view has to own its values before any of them may be removed
+  if( this->isView() )
+    _values.assign( this->begin(), this->end() );
+
+  _values.erase( _values.begin() );
+
+  _data        = _values.data();
+  _length      = _values.size();
+  _squaredSums = nullptr;
+}
+
+void TimeSeries::pop_back()
+{
+  if( this->isView() )
+    _values.assign( this->begin(), this->end() );
+
+  _values.pop_back();
+
+  _data        = _values.data();
+  _length      = _values.size();
+  _squaredSums = nullptr;
+}
+
 bool TimeSeries::operator==( const TimeSeries& other ) const noexcept
 {
   if( this->length() != other.length() )
@@ -44,33 +116,8 @@ TimeSeries::ValueType TimeSeries::distance( const TimeSeries& other ) const noex
   if( T1->length() > T2->length() )
     std::swap( T1, T2 );
 
-  ValueType distance = std::numeric_limits<ValueType>::max();
-
-  for( std::size_t i = 0; i <= T2->length() - T1->length(); i++ )
-  {
-    ValueType temp = ValueType();
-    for( std::size_t j = 0; j < T1->length(); j++ )
-    {
-      auto x = (*T2)[i+j];
-      auto y = (*T1)[  j];
-
-      temp += (x-y) * (x-y);
-
-      // Abandon early if we are already worse than the current best
-      // estimate.
-      if( temp > distance )
-        break;
-    }
-
-    distance = std::min( distance, temp );
-
-    // This is the closest possible distance, so we might as well stop
-    // calculating here.
-    if( distance == ValueType() )
-      return distance;
-  }
-
-  return distance;
+  return squaredEuclideanDistance( T1->data(), T1->length(),
+                                   T2->data(), T2->length() );
 }
 
 std::istream& operator>>( std::istream& in, TimeSeries& T )
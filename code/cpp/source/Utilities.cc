@@ -10,6 +10,10 @@
 
 #include <cassert>
 
+#if defined(__unix__) || defined(__APPLE__)
+  #include <sys/resource.h>
+#endif
+
 std::pair< std::vector<TimeSeries>, std::vector<bool> > readData( const std::string& filename, unsigned l, const std::vector<unsigned>& excludeColumns )
 {
   std::ifstream in( filename );
@@ -107,3 +111,21 @@ std::pair<double, double> standardizeData( std::vector<TimeSeries>& timeSeries )
 
   return std::make_pair( mu, sigma );
 }
+
+std::size_t peakMemoryUsage()
+{
+#if defined(__unix__) || defined(__APPLE__)
+  struct rusage usage;
+  if( getrusage( RUSAGE_SELF, &usage ) != 0 )
+    return 0;
+
+  // Linux reports kilobytes, whereas Mac OS X reports bytes
+  #ifdef __APPLE__
+    return std::size_t( usage.ru_maxrss );
+  #else
+    return std::size_t( usage.ru_maxrss ) * 1024;
+  #endif
+#else
+  return 0;
+#endif
+}
@@ -0,0 +1,252 @@
+#include "distances/DTW.hh"
+
+#include "SquaredEuclideanDistance.hh"
+#include "TimeSeries.hh"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+
+/**
+  Calculates the upper and the lower envelope of a sequence, i.e. the
+  maximum and the minimum of all values within r positions.
+*/
+
+void envelope( const double* values, std::size_t n, std::size_t r,
+               std::vector<double>& upper,
+               std::vector<double>& lower )
+{
+  upper.resize( n );
+  lower.resize( n );
+
+  for( std::size_t j = 0; j < n; j++ )
+  {
+    auto begin = j >= r ? j - r : 0;
+    auto end   = std::min( n, j + r + 1 );
+
+    upper[j] = *std::max_element( values + begin, values + end );
+    lower[j] = *std::min_element( values + begin, values + end );
+  }
+}
+
+/**
+  Calculates LB_Keogh, i.e. the sum of the squared distances of all
+  values to the envelope of the other sequence. Returns early once the
+  bound exceeds the limit.
+*/
+
+double keogh( const double* values, std::size_t n,
+              const double* upper,
+              const double* lower,
+              double limit ) noexcept
+{
+  double bound = 0.0;
+
+  for( std::size_t j = 0; j < n; j++ )
+  {
+    // At most one of both differences is positive
+    auto d = std::max( values[j] - upper[j], 0.0 ) + std::max( lower[j] - values[j], 0.0 );
+    bound += d * d;
+
+    if( bound > limit )
+      break;
+  }
+
+  return bound;
+}
+
+/**
+  Stores the bounds of LB_Keogh for all suffixes of a sequence, which
+  permit abandoning the dynamic program row by row.
+*/
+
+void suffixBounds( const double* values, std::size_t n,
+                   const double* upper,
+                   const double* lower,
+                   std::vector<double>& suffixes )
+{
+  suffixes.resize( n + 1 );
+  suffixes[n] = 0.0;
+
+  for( std::size_t j = n; j > 0; j-- )
+  {
+    auto d        = std::max( values[j-1] - upper[j-1], 0.0 ) + std::max( lower[j-1] - values[j-1], 0.0 );
+    suffixes[j-1] = suffixes[j] + d * d;
+  }
+}
+
+/**
+  Dynamic program for the DTW distance of two sequences of length n with
+  a band of width r. Row a of the matrix refers to the a-th value of the
+  first sequence, whose suffixes are bounded from below by `suffixes`.
+  The calculation is abandoned once every path is guaranteed to exceed
+  the limit; the result is infinite in this case.
+*/
+
+double warp( const double* a, const double* b, std::size_t n, std::size_t r,
+             const std::vector<double>& suffixes,
+             double limit,
+             std::vector<double>& previous,
+             std::vector<double>& current )
+{
+  constexpr double infinity = std::numeric_limits<double>::infinity();
+
+  previous.assign( n, infinity );
+  current.assign( n, infinity );
+
+  for( std::size_t i = 0; i < n; i++ )
+  {
+    auto begin = i >= r ? i - r : 0;
+    auto end   = std::min( n, i + r + 1 );
+
+    // The row still contains the values of row i - 2. Only the cell to
+    // the left of the band is read, so it must not be reused.
+    if( begin > 0 )
+      current[begin-1] = infinity;
+
+    double minimum = infinity;
+
+    for( std::size_t j = begin; j < end; j++ )
+    {
+      auto cost = ( a[i] - b[j] ) * ( a[i] - b[j] );
+
+      if( i == 0 && j == 0 )
+        current[j] = cost;
+      else
+      {
+        auto best = previous[j];
+
+        if( j > 0 )
+          best = std::min( best, std::min( previous[j-1], current[j-1] ) );
+
+        current[j] = best + cost;
+      }
+
+      minimum = std::min( minimum, current[j] );
+    }
+
+    if( minimum + suffixes[i+1] > limit )
+      return infinity;
+
+    std::swap( previous, current );
+  }
+
+  return previous[n-1];
+}
+
+} // end of anonymous namespace
+
+DTWDistance::DTWDistance( ValueType band )
+  : _band( band )
+{
+  if( _band < ValueType() )
+    throw std::runtime_error( "Band must be nonnegative" );
+}
+
+DTWDistance::ValueType DTWDistance::operator()( const TimeSeries& S, const TimeSeries& T ) const
+{
+  const TimeSeries* shapelet   = &S;
+  const TimeSeries* timeSeries = &T;
+
+  if( shapelet->length() > timeSeries->length() )
+    std::swap( shapelet, timeSeries );
+
+  auto n = shapelet->length();
+  auto m = timeSeries->length();
+
+  assert( n <= m );
+
+  if( n == 0 )
+    return ValueType();
+
+  auto x = shapelet->data();
+  auto y = timeSeries->data();
+
+  auto width = _band < 1 ? std::floor( _band * ValueType( n ) ) : std::floor( _band );
+  auto r     = std::min( n - 1, static_cast<std::size_t>( width ) );
+
+  // Without any warping, only the diagonal path remains, whose sum is
+  // calculated in the same order as the squared Euclidean distance.
+  auto euclidean = squaredEuclideanDistance( x, n, y, m );
+
+  if( r == 0 )
+    return euclidean;
+
+  thread_local std::vector<double> shapeletUpper, shapeletLower;
+  thread_local std::vector<double> seriesUpper, seriesLower;
+  thread_local std::vector<double> suffixes;
+  thread_local std::vector<double> previous, current;
+
+  envelope( x, n, r, shapeletUpper, shapeletLower );
+  envelope( y, m, r, seriesUpper, seriesLower );
+
+  // The bounds are only compared with a margin that covers the round-off
+  // errors of the dynamic program, so pruning never changes the result.
+  constexpr double epsilon = std::numeric_limits<double>::epsilon();
+
+  auto margin = 1.0 + 8.0 * double( n + 2 ) * epsilon;
+
+  // The diagonal path is one of the paths of every window, so the best
+  // Euclidean distance is an upper bound that makes pruning effective
+  // right from the start. It is attained by the DTW distance of its own
+  // window or undercut by another one.
+  ValueType distance = euclidean;
+
+  for( std::size_t i = 0; i + n <= m; i++ )
+  {
+    auto window = y + i;
+    auto limit  = distance * margin;
+
+    // LB_Kim: the first and the last values are always aligned
+    {
+      auto d0 = x[0]   - window[0];
+      auto d1 = x[n-1] - window[n-1];
+
+      if( ( n > 1 ? d0 * d0 + d1 * d1 : d0 * d0 ) > limit )
+        continue;
+    }
+
+    // LB_Keogh of the window with respect to the envelope of the shapelet
+    // and vice versa. The envelope of the window is taken from the whole
+    // time series, which is wider and thus remains a lower bound.
+    auto windowBound = keogh( window, n, shapeletUpper.data(), shapeletLower.data(), limit );
+    if( windowBound > limit )
+      continue;
+
+    auto shapeletBound = keogh( x, n, seriesUpper.data() + i, seriesLower.data() + i, limit );
+    if( shapeletBound > limit )
+      continue;
+
+    // The tighter bound provides the cumulative bounds for abandoning the
+    // dynamic program, so its sequence determines the rows.
+    double temp = 0.0;
+
+    if( shapeletBound >= windowBound )
+    {
+      suffixBounds( x, n, seriesUpper.data() + i, seriesLower.data() + i, suffixes );
+      temp = warp( x, window, n, r, suffixes, limit, previous, current );
+    }
+    else
+    {
+      suffixBounds( window, n, shapeletUpper.data(), shapeletLower.data(), suffixes );
+      temp = warp( window, x, n, r, suffixes, limit, previous, current );
+    }
+
+    distance = std::min( distance, temp );
+
+    // This is the closest possible distance, so we might as well stop
+    // calculating here.
+    if( distance == ValueType() )
+      return distance;
+  }
+
+  return distance;
+}
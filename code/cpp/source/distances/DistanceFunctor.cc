@@ -1 +1,11 @@
 #include "distances/DistanceFunctor.hh"
+#include "distances/DistanceEngine.hh"
+
+#include "TimeSeries.hh"
+
+void DistanceFunctor::distances( const TimeSeries& S,
+                                 const std::vector<TimeSeries>& timeSeries,
+                                 ValueType* distances ) const
+{
+  calculateDistances( *this, S, timeSeries, distances );
+}
@@ -1,13 +1,130 @@
 #include "distances/Lp.hh"
 
-#include "PiecewiseLinearFunction.hh"
+#include "TimeSeries.hh"
 
+#include <algorithm>
 #include <limits>
 #include <utility>
 
 #include <cassert>
 #include <cmath>
 
+namespace
+{
+
+// The policies below calculate the contribution of a single segment of
+// the piecewise linear difference between the shapelet and a window. A
+// segment connects the differences a and b at two consecutive indices,
+// i.e. the integral is taken over an interval of unit length.
+
+/** Integral of the absolute value of the segment, without powers */
+struct Linear
+{
+  double operator()( double a, double b ) const noexcept
+  {
+    return std::abs( a + b ) / 2;
+  }
+};
+
+/** Integral of the squared segment; this is never negative */
+struct Quadratic
+{
+  double operator()( double a, double b ) const noexcept
+  {
+    return ( a * a + a * b + b * b ) / 3;
+  }
+};
+
+/** Integral of the p-th power of the segment, for arbitrary powers */
+struct Power
+{
+  double p;
+
+  double operator()( double a, double b ) const noexcept
+  {
+    auto m = b - a;
+
+    if( m == 0.0 )
+      return std::abs( std::pow( a, p ) );
+    else
+      return std::abs( ( std::pow( b, p + 1 ) - std::pow( a, p + 1 ) ) / ( m * ( p + 1 ) ) );
+  }
+};
+
+/**
+  Calculates the minimum distance of all windows of a sequence to the
+  shapelet by accumulating the integrals of all segments directly from
+  both ranges of values. Windows are abandoned early as soon as their
+  sum exceeds the current best distance.
+*/
+
+template <class Integral> double distance( const Integral& integral,
+                                           const double* shapelet, std::size_t n,
+                                           const double* sequence, std::size_t m )
+{
+  double distance = std::numeric_limits<double>::max();
+
+  for( std::size_t i = 0; i + n <= m; i++ )
+  {
+    auto window = sequence + i;
+    double temp = 0.0;
+
+    for( std::size_t j = 0; j + 1 < n; j++ )
+    {
+      temp += integral( shapelet[j] - window[j], shapelet[j+1] - window[j+1] );
+
+      // Abandon early if we are already worse than the current best
+      // estimate.
+      if( temp > distance )
+        break;
+    }
+
+    distance = std::min( distance, temp );
+
+    // This is the closest possible distance, so we might as well stop
+    // calculating here.
+    if( distance == 0.0 )
+      return distance;
+  }
+
+  return distance;
+}
+
+/**
+  Supremum norm, which is the largest difference at any index (note that
+  the differences are not taken in absolute value, so the norm is never
+  smaller than zero, though).
+*/
+
+double supremum( const double* shapelet, std::size_t n,
+                 const double* sequence, std::size_t m )
+{
+  double distance = std::numeric_limits<double>::max();
+
+  for( std::size_t i = 0; i + n <= m; i++ )
+  {
+    auto window = sequence + i;
+    double temp = 0.0;
+
+    for( std::size_t j = 0; j + 1 < n; j++ )
+    {
+      temp = std::max( temp, std::max( shapelet[j] - window[j], shapelet[j+1] - window[j+1] ) );
+
+      if( temp > distance )
+        break;
+    }
+
+    distance = std::min( distance, temp );
+
+    if( distance == 0.0 )
+      return distance;
+  }
+
+  return distance;
+}
+
+} // end of anonymous namespace
+
 LpDistance::LpDistance( ValueType p )
   : _p( p )
 {
@@ -25,25 +142,17 @@ LpDistance::ValueType LpDistance::operator()( const TimeSeries& S, const TimeSer
   auto m = timeSeries->length();
 
   assert( n <= m );
+  assert( _p >= 0 );
 
-  auto f      = PiecewiseLinearFunction( shapelet->begin(), shapelet->end() );
-  ValueType d = std::numeric_limits<ValueType>::max();
-
-  // For each offset, construct a time series of the correct length and
-  // compare it against the shapelet.
-  for( std::size_t i = 0; i < m - n + 1; i++ )
-  {
-    std::vector<ValueType> values( n );
-
-    std::copy( timeSeries->begin() + static_cast<long>(i),
-               timeSeries->begin() + static_cast<long>(i + n),
-               values.begin() );
-
-    assert( values.size() == n );
-
-    auto g = PiecewiseLinearFunction( values.begin(), values.end() );
-    d = std::min( d, std::abs( (f - g).norm( _p ) ) );
-  }
+  auto x = shapelet->data();
+  auto y = timeSeries->data();
 
-  return d;
+  if( _p == 0 )
+    return supremum( x, n, y, m );
+  else if( _p == 1 )
+    return distance( Linear(), x, n, y, m );
+  else if( _p == 2 )
+    return distance( Quadratic(), x, n, y, m );
+  else
+    return distance( Power{ _p }, x, n, y, m );
 }
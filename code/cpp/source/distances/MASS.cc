@@ -0,0 +1,135 @@
+#include "distances/MASS.hh"
+
+#include "FFT.hh"
+#include "TimeSeries.hh"
+
+#include <algorithm>
+#include <complex>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <cmath>
+
+MASSDistance::ValueType MASSDistance::operator()( const TimeSeries& S, const TimeSeries& T ) const
+{
+  const TimeSeries* T1 = &S;
+  const TimeSeries* T2 = &T;
+
+  if( T1->length() > T2->length() )
+    std::swap( T1, T2 );
+
+  auto n = T1->length();
+  auto m = T2->length();
+
+  if( n == 0 )
+    return ValueType();
+
+  // Buffers are re-used for all pairs that are processed by a thread in
+  // order to prevent repeated allocations.
+  thread_local std::vector< std::complex<double> > workspace;
+  thread_local std::vector<double> dotProducts;
+  thread_local std::vector<ValueType> sums;
+  thread_local std::vector< std::pair<ValueType, std::size_t> > offsets;
+
+  // Cumulative sums of squares of the time series. Their round-off
+  // errors are covered by the tolerance of the refinement below.
+  sums.resize( m + 1 );
+  sums[0] = 0.0;
+
+  for( std::size_t i = 0; i < m; i++ )
+    sums[i+1] = sums[i] + (*T2)[i] * (*T2)[i];
+
+  ValueType shapeletSum = 0.0;
+  for( std::size_t j = 0; j < n; j++ )
+    shapeletSum += (*T1)[j] * (*T1)[j];
+
+  // A single missing or infinite value spreads to every value of the
+  // profile via the transform, whereas the scan only skips the windows
+  // that contain it. Such pairs are thus left to the scan.
+  if( !std::isfinite( shapeletSum + sums[m] ) )
+    return T1->distance( *T2 );
+
+  slidingDotProducts( &(*T1)[0], n, &(*T2)[0], m, workspace, dotProducts );
+
+  // Distance profile --------------------------------------------------
+
+  offsets.clear();
+  offsets.reserve( dotProducts.size() );
+
+  ValueType minimum = std::numeric_limits<ValueType>::max();
+
+  for( std::size_t i = 0; i < dotProducts.size(); i++ )
+  {
+    auto d = sums[i+n] - sums[i] + shapeletSum - 2 * dotProducts[i];
+
+    offsets.emplace_back( d, i );
+    minimum = std::min( minimum, d );
+  }
+
+  // Refinement --------------------------------------------------------
+  //
+  // The error of the dot products is bounded by a small multiple of the
+  // product of the norms of both sequences and the machine precision.
+  // This bound is rather conservative, but it only affects the number of
+  // offsets that have to be checked again.
+
+  auto tolerance = std::numeric_limits<ValueType>::epsilon()
+                 * static_cast<ValueType>( transformSize( m ) )
+                 * ( shapeletSum + sums[m] );
+
+  auto last = std::partition( offsets.begin(), offsets.end(),
+                              [&minimum, &tolerance] ( const std::pair<ValueType, std::size_t>& offset )
+                              {
+                                return offset.first <= minimum + 2 * tolerance;
+                              } );
+
+  std::sort( offsets.begin(), last );
+
+  ValueType distance = std::numeric_limits<ValueType>::max();
+
+  for( auto it = offsets.begin(); it != last; ++it )
+  {
+    auto i = it->second;
+
+    ValueType temp = ValueType();
+    for( std::size_t j = 0; j < n; j++ )
+    {
+      auto x = (*T2)[i+j];
+      auto y = (*T1)[  j];
+
+      temp += (x-y) * (x-y);
+
+      // Abandon early if we are already worse than the current best
+      // estimate.
+      if( temp > distance )
+        break;
+    }
+
+    distance = std::min( distance, temp );
+
+    // This is the closest possible distance, so we might as well stop
+    // calculating here.
+    if( distance == ValueType() )
+      return distance;
+  }
+
+  return distance;
+}
+
+bool MASSDistance::cheaper( std::size_t n, std::size_t m ) noexcept
+{
+  if( n == 0 || n > m )
+    return false;
+
+  auto N = static_cast<double>( transformSize( m ) );
+
+  // Rough costs of both approaches in terms of the operations of the
+  // scan. They have been calibrated on random walks. A butterfly of the
+  // transform is about as expensive as three operations of the scan, and
+  // early abandoning is assumed to skip half of every window.
+  auto profileCost = 6.0 * N * std::log2( N ) + 16.0 * double( m );
+  auto scanCost    = 0.5 * double( n ) * double( m - n + 1 );
+
+  return profileCost < scanCost;
+}
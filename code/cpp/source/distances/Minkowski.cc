@@ -1,5 +1,7 @@
 #include "distances/Minkowski.hh"
 
+#include "LowerBounds.hh"
+#include "SquaredEuclideanDistance.hh"
 #include "TimeSeries.hh"
 
 #include <algorithm>
@@ -9,36 +11,42 @@
 
 #include <cmath>
 
-MinkowskiDistance::MinkowskiDistance( ValueType p )
-  : _p( p )
+namespace
 {
-  if( _p < ValueType() )
-    throw std::runtime_error( "Power parameter must be nonnegative" );
-}
 
-MinkowskiDistance::ValueType MinkowskiDistance::operator()( const TimeSeries& S, const TimeSeries& T ) const
+constexpr std::size_t minOffsets = 128;
+
+/**
+  Kernel for integer powers, including p = 0, which denotes the maximum
+  norm. Powers in (0,1] are treated as p = 1.
+*/
+
+double integerKernel( const double* pattern, std::size_t n,
+                      const double* sequence, std::size_t m,
+                      double p )
 {
-  const TimeSeries* T1 = &S;
-  const TimeSeries* T2 = &T;
+  return minkowskiDistance( pattern, n, sequence, m, p > 0 && p <= 1 ? 1u : unsigned( p ) );
+}
 
-  if( T1->length() > T2->length() )
-    std::swap( T1, T2 );
+/** Kernel for all other powers, which requires `std::pow()` */
+double genericKernel( const double* pattern, std::size_t n,
+                      const double* sequence, std::size_t m,
+                      double p )
+{
+  // Powers are expensive enough for the lower bounds to pay off. Setting
+  // up the bounds takes linear time, though, which is not worth it for a
+  // few offsets only.
+  if( m - n >= minOffsets )
+    return cascadeDistance( pattern, n, sequence, m, Norm::Power, p );
 
-  ValueType distance = std::numeric_limits<ValueType>::max();
+  double distance = std::numeric_limits<double>::max();
 
-  for( std::size_t i = 0; i <= T2->length() - T1->length(); i++ )
+  for( std::size_t i = 0; i <= m - n; i++ )
   {
-    ValueType temp = ValueType();
-    for( std::size_t j = 0; j < T1->length(); j++ )
+    double temp = 0.0;
+    for( std::size_t j = 0; j < n; j++ )
     {
-      auto x = (*T2)[i+j];
-      auto y = (*T1)[  j];
-      auto d = static_cast<ValueType>( std::abs( x - y ) );
-
-      if( _p > 0 )
-        temp += _p > 1 ? std::pow( d, _p ) : d;
-      else
-        temp = std::max( temp, d );
+      temp += std::pow( std::abs( sequence[i+j] - pattern[j] ), p );
 
       // Abandon early if we are already worse than the current best
       // estimate.
@@ -50,9 +58,39 @@ MinkowskiDistance::ValueType MinkowskiDistance::operator()( const TimeSeries& S,
 
     // This is the closest possible distance, so we might as well stop
     // calculating here.
-    if( distance == ValueType() )
+    if( distance == 0.0 )
       return distance;
   }
 
   return distance;
 }
+
+} // end of anonymous namespace
+
+MinkowskiDistance::MinkowskiDistance( ValueType p )
+  : _p( p )
+{
+  if( _p < ValueType() )
+    throw std::runtime_error( "Power parameter must be nonnegative" );
+
+  // Select the kernel once instead of branching on the power for every
+  // value: integer powers do not require `std::pow()`.
+  if( _p <= 1 || ( _p <= maxIntegerPower && _p == std::floor( _p ) ) )
+    _kernel = integerKernel;
+  else
+    _kernel = genericKernel;
+}
+
+MinkowskiDistance::ValueType MinkowskiDistance::operator()( const TimeSeries& S, const TimeSeries& T ) const
+{
+  const TimeSeries* T1 = &S;
+  const TimeSeries* T2 = &T;
+
+  if( T1->length() > T2->length() )
+    std::swap( T1, T2 );
+
+  if( T1->length() == 0 )
+    return ValueType();
+
+  return _kernel( T1->data(), T1->length(), T2->data(), T2->length(), _p );
+}
@@ -0,0 +1,118 @@
+#include "distances/ZNormalized.hh"
+
+#include "TimeSeries.hh"
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <cassert>
+#include <cmath>
+
+ZNormalizedDistance::ValueType ZNormalizedDistance::operator()( const TimeSeries& S, const TimeSeries& T ) const
+{
+  const TimeSeries* shapelet   = &S;
+  const TimeSeries* timeSeries = &T;
+
+  if( shapelet->length() > timeSeries->length() )
+    std::swap( shapelet, timeSeries );
+
+  auto n = shapelet->length();
+  auto m = timeSeries->length();
+
+  assert( n <= m );
+
+  if( n == 0 )
+    return ValueType();
+
+  auto x = shapelet->data();
+  auto y = timeSeries->data();
+
+  // Normalize the shapelet once ---------------------------------------
+
+  thread_local std::vector<ValueType> pattern;
+  thread_local std::vector<ValueType> sums;
+  thread_local std::vector<ValueType> squares;
+
+  pattern.resize( n );
+
+  {
+    ValueType mean = ValueType();
+    for( std::size_t j = 0; j < n; j++ )
+      mean += x[j];
+
+    mean /= ValueType( n );
+
+    ValueType variance = ValueType();
+    for( std::size_t j = 0; j < n; j++ )
+      variance += ( x[j] - mean ) * ( x[j] - mean );
+
+    // Variances at the level of the round-off errors of the mean are
+    // treated as those of a constant shapelet.
+    variance /= ValueType( n );
+
+    auto epsilon = std::numeric_limits<ValueType>::epsilon();
+    auto scale   = variance > ValueType( n ) * epsilon * mean * mean ? 1 / std::sqrt( variance ) : ValueType();
+
+    for( std::size_t j = 0; j < n; j++ )
+      pattern[j] = ( x[j] - mean ) * scale;
+  }
+
+  // Rolling statistics of the windows ---------------------------------
+  //
+  // The values are shifted by their first entry before accumulating
+  // them, which reduces the cancellation in the variances of series
+  // that are far away from zero.
+
+  auto shift = y[0];
+
+  sums.resize( m + 1 );
+  squares.resize( m + 1 );
+
+  sums[0]    = ValueType();
+  squares[0] = ValueType();
+
+  for( std::size_t i = 0; i < m; i++ )
+  {
+    auto value   = y[i] - shift;
+    sums[i+1]    = sums[i] + value;
+    squares[i+1] = squares[i] + value * value;
+  }
+
+  auto epsilon        = std::numeric_limits<ValueType>::epsilon();
+  ValueType distance = std::numeric_limits<ValueType>::max();
+
+  for( std::size_t i = 0; i <= m - n; i++ )
+  {
+    auto mean     = ( sums[i+n] - sums[i] ) / ValueType( n );
+    auto variance = ( squares[i+n] - squares[i] ) / ValueType( n ) - mean * mean;
+
+    // Differences of the cumulative sums are subject to round-off errors
+    // that grow with their magnitude; variances below them are those of
+    // windows without any variation.
+    auto tolerance = 4 * ValueType( i + n + 1 ) * epsilon * squares[i+n] / ValueType( n );
+    auto scale     = variance > tolerance ? 1 / std::sqrt( variance ) : ValueType();
+    auto offset    = ( mean + shift ) * scale;
+
+    ValueType temp = ValueType();
+    for( std::size_t j = 0; j < n; j++ )
+    {
+      auto d = pattern[j] - ( y[i+j] * scale - offset );
+      temp  += d * d;
+
+      // Abandon early if we are already worse than the current best
+      // estimate.
+      if( temp > distance )
+        break;
+    }
+
+    distance = std::min( distance, temp );
+
+    // This is the closest possible distance, so we might as well stop
+    // calculating here.
+    if( distance == ValueType() )
+      return distance;
+  }
+
+  return distance;
+}
@@ -0,0 +1,437 @@
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include <cassert>
+#include <cmath>
+
+#include "ContingencyTable.hh"
+#include "ContingencyTableBuilder.hh"
+#include "ContingencyTables.hh"
+#include "LookupTable.hh"
+
+int main( int, char** )
+{
+  // Different marginals in the same process ---------------------------
+  //
+  // Every problem size has its own lookup table, so tables of different
+  // sizes may be used in an interleaved manner.
+
+  {
+    LookupTable L1( 10, 4 );
+    LookupTable L2( 20, 5 );
+
+    ContingencyTable C1( 10, 4, 0.0, false, L1 );
+    ContingencyTable C2( 20, 5, 0.0, false, L2 );
+
+    for( unsigned rs = 0; rs <= 10; rs++ )
+      assert( C1.min_attainable_p( rs ) == L1[rs] );
+
+    for( unsigned rs = 0; rs <= 20; rs++ )
+      assert( C2.min_attainable_p( rs ) == L2[rs] );
+
+    // The most extreme split of the data is only attainable if all
+    // items are in one column.
+    assert( C1.min_attainable_p(  0 ) == 1.0 );
+    assert( C1.min_attainable_p( 10 ) == 1.0 );
+    assert( C1.min_attainable_p(  4 ) <  1.0 );
+  }
+
+  // Pseudocounts ------------------------------------------------------
+
+  {
+    LookupTable L( 14, 6 );
+    ContingencyTable C( 10, 4, 0.0, true, L );
+
+    assert( C.n()  == 4 );
+    assert( C.rs() == 2 );
+
+    C.insert( -1.0, true );
+    C.insert(  1.0, false );
+
+    assert( C.as() == 2 );
+    assert( C.cs() == 2 );
+    assert( C.min_attainable_p() == L[3] );
+  }
+
+  // Insertion ---------------------------------------------------------
+
+  {
+    LookupTable L( 4, 2 );
+    ContingencyTables tables( 4, 2, false, L );
+
+    tables.insert( 1.0, true  );
+    tables.insert( 2.0, true  );
+    tables.insert( 3.0, false );
+    tables.insert( 1.0, false );
+
+    // One table per distinct distance
+    assert( tables.size() == 3 );
+
+    auto it = tables.begin();
+
+    assert( it->threshold() == 1.0 );
+    assert( it->as() == 1 && it->bs() == 1 && it->cs() == 1 && it->ds() == 1 );
+
+    ++it;
+
+    assert( it->threshold() == 2.0 );
+    assert( it->as() == 2 && it->bs() == 0 && it->cs() == 1 && it->ds() == 1 );
+
+    ++it;
+
+    assert( it->threshold() == 3.0 );
+    assert( it->as() == 2 && it->bs() == 0 && it->cs() == 0 && it->ds() == 2 );
+  }
+
+  // Pruning -----------------------------------------------------------
+  //
+  // Pruning must only remove the tables that are not testable, so the
+  // result does not depend on the order of the elements.
+
+  {
+    LookupTable L( 12, 5 );
+
+    std::vector<double> distances = { 0.3, 1.2, 0.7, 2.5, 0.1, 1.9, 0.7, 3.1, 0.2, 2.2, 1.1, 0.5 };
+    std::vector<bool> labels      = { true, false, true, false, true, false, false, false, true, false, true, false };
+
+    ContingencyTables unpruned( 12, 5, false, L );
+
+    for( std::size_t i = 0; i < distances.size(); i++ )
+      unpruned.insert( distances[i], labels[i] );
+
+    for( unsigned rs = 0; rs <= 12; rs++ )
+    {
+      auto p = L[rs];
+
+      std::vector<ContingencyTable> expected;
+      std::copy_if( unpruned.begin(), unpruned.end(), std::back_inserter( expected ),
+        [&p] ( const ContingencyTable& table )
+        {
+          return table.min_attainable_p() <= p;
+        }
+      );
+
+      ContingencyTables forward( 12, 5, false, L );
+      ContingencyTables backward( 12, 5, false, L );
+
+      for( std::size_t i = 0; i < distances.size(); i++ )
+      {
+        forward.insert( distances[i], labels[i], p );
+        backward.insert( distances[ distances.size() - i - 1 ], labels[ distances.size() - i - 1 ], p );
+      }
+
+      assert( forward.size()  == expected.size() );
+      assert( backward.size() == expected.size() );
+
+      assert( std::equal( expected.begin(), expected.end(), forward.begin() ) );
+      assert( std::equal( expected.begin(), expected.end(), backward.begin() ) );
+    }
+  }
+
+  // Reachable marginals -----------------------------------------------
+  //
+  // The smallest minimum attainable $p$-value over a range of marginals
+  // is the same as the one of a linear search, for both tests.
+
+  for( auto test : { Test::ChiSquared, Test::Fisher } )
+  {
+    for( unsigned n1 = 1; n1 < 16; n1 += 3 )
+    {
+      LookupTable L( 16, n1, test );
+
+      for( unsigned rsMin = 0; rsMin <= 16; rsMin++ )
+      {
+        for( unsigned rsMax = rsMin; rsMax <= 16; rsMax++ )
+        {
+          auto p = L[rsMin];
+          for( unsigned rs = rsMin; rs <= rsMax; rs++ )
+            p = std::min( p, L[rs] );
+
+          assert( L.min( rsMin, rsMax ) == p );
+        }
+      }
+    }
+  }
+
+  // Tables are only pruned if no completion of them is testable, i.e. if
+  // every way of distributing the missing elements over both columns
+  // yields a marginal whose minimum attainable $p$-value is too large.
+  // Only looking at the extreme completions, as the minimum optimistic
+  // $p$-value does, may overestimate this for some tables.
+
+  {
+    LookupTable L( 12, 5 );
+
+    std::vector<double> distances = { 0.3, 1.2, 0.7, 2.5, 0.1, 1.9, 0.7, 3.1, 0.2, 2.2, 1.1, 0.5 };
+    std::vector<bool> labels      = { true, false, true, false, true, false, false, false, true, false, true, false };
+
+    bool overestimated = false;
+
+    for( std::size_t k = 1; k <= distances.size(); k++ )
+    {
+      ContingencyTables tables( 12, 5, false, L );
+
+      for( std::size_t i = 0; i < k; i++ )
+        tables.insert( distances[i], labels[i] );
+
+      for( auto&& table : tables )
+      {
+        auto m1 = L.n1() - table.n1();
+        auto m0 = L.n() - L.n1() - table.n0();
+        auto p  = L[ table.rs() ];
+
+        for( unsigned a1 = 0; a1 <= m1; a1++ )
+          for( unsigned d0 = 0; d0 <= m0; d0++ )
+            p = std::min( p, L[ table.rs() + a1 + d0 ] );
+
+        assert( table.min_reachable_p() == p );
+
+        overestimated = overestimated || table.min_optimistic_p() > p;
+      }
+    }
+
+    assert( overestimated );
+    (void) overestimated;
+  }
+
+  // Sort and sweep ----------------------------------------------------
+  //
+  // The builder has to create the same tables as the incremental class,
+  // regardless of pruning and pseudocounts.
+
+  for( bool withPseudocounts : { false, true } )
+  {
+    LookupTable L( withPseudocounts ? 16 : 12, withPseudocounts ? 7 : 5 );
+    ContingencyTableBuilder builder( 12, 5, withPseudocounts, L );
+
+    std::vector<double> distances = { 0.3, 1.2, 0.7, 2.5, 0.1, 1.9, 0.7, 3.1, 0.2, 2.2, 1.1, 0.5 };
+    std::vector<bool> labels      = { true, false, true, false, true, false, false, false, true, false, true, false };
+
+    for( unsigned rs = 0; rs <= L.n(); rs++ )
+    {
+      for( auto p : { 0.0L, L[rs] } )
+      {
+        ContingencyTables expected( 12, 5, withPseudocounts, L );
+        std::vector<ContingencyTableBuilder::DistanceLabelPair> distanceLabelPairs;
+
+        for( std::size_t i = 0; i < distances.size(); i++ )
+        {
+          expected.insert( distances[i], labels[i], p );
+          distanceLabelPairs.emplace_back( distances[i], labels[i] );
+        }
+
+        std::vector<ContingencyTable> tables;
+        auto numPruned = builder( distanceLabelPairs, tables, p );
+
+        assert( tables.size() == expected.size() );
+        assert( tables.size() + numPruned == 11 ); // one table per distinct distance
+
+        (void) numPruned;
+
+        assert( std::equal( tables.begin(), tables.end(), expected.begin(),
+                            [] ( const ContingencyTable& table, const ContingencyTable& other )
+                            {
+                              return table == other && table.threshold() == other.threshold();
+                            } ) );
+      }
+    }
+  }
+
+  // Missing distances -------------------------------------------------
+  //
+  // Items with a missing distance lie above every threshold. They behave
+  // like items with a larger distance than all others, except that they
+  // do not create a table of their own.
+
+  {
+    LookupTable L( 8, 4 );
+    ContingencyTableBuilder builder( 8, 4, false, L );
+
+    auto nan = std::numeric_limits<double>::quiet_NaN();
+
+    std::vector<double> distances = { 0.5, nan, 0.2, 1.5, nan, 0.5, nan, 0.9 };
+    std::vector<bool> labels      = { true, true, false, true, false, false, true, false };
+
+    for( auto p : { 0.0L, L[4] } )
+    {
+      std::vector<ContingencyTableBuilder::DistanceLabelPair> withMissing;
+      std::vector<ContingencyTableBuilder::DistanceLabelPair> withLarge;
+
+      for( std::size_t i = 0; i < distances.size(); i++ )
+      {
+        withMissing.emplace_back( distances[i], labels[i] );
+        withLarge.emplace_back( std::isnan( distances[i] ) ? 1e300 : distances[i], labels[i] );
+      }
+
+      std::vector<ContingencyTable> tables;
+      std::vector<ContingencyTable> expected;
+
+      builder( withMissing, tables, p );
+      builder( withLarge, expected, p );
+
+      if( !expected.empty() && expected.back().threshold() == 1e300 )
+        expected.pop_back();
+
+      assert( tables.size() == expected.size() );
+      assert( std::equal( tables.begin(), tables.end(), expected.begin() ) );
+
+      assert( std::none_of( tables.begin(), tables.end(),
+                            [] ( const ContingencyTable& table )
+                            {
+                              return std::isnan( table.threshold() );
+                            } ) );
+    }
+
+    // Only missing distances
+    std::vector<ContingencyTableBuilder::DistanceLabelPair> distanceLabelPairs;
+
+    for( std::size_t i = 0; i < distances.size(); i++ )
+      distanceLabelPairs.emplace_back( nan, labels[i] );
+
+    std::vector<ContingencyTable> tables;
+    builder( distanceLabelPairs, tables );
+
+    assert( tables.empty() );
+  }
+
+  // Cached $p$-values -------------------------------------------------
+  //
+  // Tables with equal cells share their $p$-value, regardless of their
+  // threshold, and the cached values are the same as the ones that are
+  // calculated for the first time.
+
+  {
+    LookupTable L1( 12, 5 );
+    LookupTable L2( 12, 5 );
+
+    for( unsigned as = 0; as <= 5; as++ )
+    {
+      for( unsigned ds = 0; ds <= 7; ds++ )
+      {
+        ContingencyTable C( as, 5 - as, 7 - ds, ds, 0.0, L1 );
+        ContingencyTable D( as, 5 - as, 7 - ds, ds, 1.0, L1 );
+
+        auto p = C.p();
+
+        // Both are NaN for tables with an empty column
+        assert( ( std::isnan( p ) && std::isnan( D.p() ) ) || p == D.p() );
+
+        ContingencyTable E( as, 5 - as, 7 - ds, ds, 0.0, L2 );
+
+        assert( ( std::isnan( p ) && std::isnan( E.p() ) ) || p == E.p() );
+
+        (void) p;
+      }
+    }
+  }
+
+  // Concurrent lookups ------------------------------------------------
+  //
+  // Threads that request the same $p$-values at the same time obtain the
+  // same values as a single thread.
+
+  {
+    LookupTable L1( 40, 17 );
+    LookupTable L2( 40, 17 );
+
+    std::vector<long double> expected;
+    for( unsigned as = 0; as <= 17; as++ )
+      for( unsigned ds = 0; ds <= 23; ds++ )
+        expected.push_back( ContingencyTable( as, 17 - as, 23 - ds, ds, 0.0, L1 ).p() );
+
+    std::vector< std::vector<long double> > actual( 4 );
+    std::vector<std::thread> threads;
+
+    for( auto&& values : actual )
+    {
+      threads.emplace_back( [&L2, &values] ()
+        {
+          for( unsigned as = 0; as <= 17; as++ )
+            for( unsigned ds = 0; ds <= 23; ds++ )
+              values.push_back( ContingencyTable( as, 17 - as, 23 - ds, ds, 0.0, L2 ).p() );
+        }
+      );
+    }
+
+    for( auto&& thread : threads )
+      thread.join();
+
+    for( auto&& values : actual )
+    {
+      bool equal = std::equal( values.begin(), values.end(), expected.begin(),
+                               [] ( long double p, long double q )
+                               {
+                                 return ( std::isnan( p ) && std::isnan( q ) ) || p == q;
+                               } );
+
+      assert( values.size() == expected.size() && equal );
+      (void) equal;
+    }
+  }
+
+  // Fisher's exact test -----------------------------------------------
+
+  {
+    // Lady tasting tea: the p-value is 34/70, and the most extreme table
+    // is attained with a probability of 1/70 on either side.
+    LookupTable L( 8, 4, Test::Fisher );
+
+    ContingencyTable C( 3, 1, 3, 1, 0.0, L );
+
+    assert( std::abs( C.p() - 34.0L / 70.0L ) < 1e-15L );
+    assert( std::abs( C.min_attainable_p() - 2.0L / 70.0L ) < 1e-15L );
+    assert( C.min_attainable_p( 0 ) == 1.0L );
+    assert( C.min_attainable_p( 8 ) == 1.0L );
+  }
+
+  {
+    // Reference implementation with binomial coefficients, which are
+    // exact for tables of this size
+    auto binomial = [] ( unsigned n, unsigned k )
+    {
+      long double result = 1.0;
+      for( unsigned i = 1; i <= k; i++ )
+        result = result * ( n - k + i ) / i;
+
+      return result;
+    };
+
+    LookupTable L( 12, 5, Test::Fisher );
+
+    for( unsigned rs = 0; rs <= 12; rs++ )
+    {
+      auto kMin = rs > 7 ? rs - 7 : 0;
+      auto kMax = std::min( rs, 5u );
+
+      auto probability = [&] ( unsigned k )
+      {
+        return binomial( 5, k ) * binomial( 7, rs - k ) / binomial( 12, rs );
+      };
+
+      long double min_p = 1.0;
+
+      for( unsigned as = kMin; as <= kMax; as++ )
+      {
+        long double expected = 0.0;
+        for( unsigned k = kMin; k <= kMax; k++ )
+        {
+          if( probability( k ) <= probability( as ) * ( 1 + 1e-7L ) )
+            expected += probability( k );
+        }
+
+        expected = std::min( expected, 1.0L );
+        min_p    = std::min( min_p, expected );
+
+        ContingencyTable C( as, 5 - as, 7 - rs + as, rs - as, 0.0, L );
+
+        assert( std::abs( C.p() - expected ) < 1e-15L );
+      }
+
+      assert( std::abs( L[rs] - min_p ) < 1e-15L );
+    }
+  }
+}
@@ -0,0 +1,797 @@
+#include <complex>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <cassert>
+#include <cmath>
+
+#include "BatchedDistances.hh"
+#include "CompactStorage.hh"
+#include "FFT.hh"
+#include "LowerBounds.hh"
+#include "PiecewiseLinearFunction.hh"
+#include "SquaredEuclideanDistance.hh"
+#include "TimeSeries.hh"
+
+#include "distances/DTW.hh"
+#include "distances/DistanceFunctor.hh"
+#include "distances/Lp.hh"
+#include "distances/MASS.hh"
+#include "distances/ZNormalized.hh"
+
+int main( int, char** )
+{
+  // Transform -----------------------------------------------------------
+
+  {
+    std::vector< std::complex<double> > values = { 1.0, 2.0, 3.0, 4.0, 0.0, 0.0, 0.0, 0.0 };
+    auto original = values;
+
+    fft( values );
+
+    // The first coefficient is the sum of all values
+    assert( std::abs( values[0] - std::complex<double>( 10.0 ) ) < 1e-12 );
+
+    fft( values, true );
+
+    for( std::size_t i = 0; i < values.size(); i++ )
+      assert( std::abs( values[i] - original[i] ) < 1e-12 );
+  }
+
+  // Sliding dot products ------------------------------------------------
+
+  {
+    std::vector<double> pattern  = { 1.0, -1.0, 2.0 };
+    std::vector<double> sequence = { 3.0, 1.0, 4.0, 1.0, 5.0, 9.0, 2.0 };
+
+    std::vector< std::complex<double> > workspace;
+    std::vector<double> result;
+
+    slidingDotProducts( pattern.data(), pattern.size(),
+                        sequence.data(), sequence.size(),
+                        workspace,
+                        result );
+
+    assert( result.size() == sequence.size() - pattern.size() + 1 );
+
+    for( std::size_t i = 0; i < result.size(); i++ )
+    {
+      double expected = 0.0;
+      for( std::size_t j = 0; j < pattern.size(); j++ )
+        expected += pattern[j] * sequence[i+j];
+
+      assert( std::abs( result[i] - expected ) < 1e-12 );
+    }
+  }
+
+  // Distance profile vs. early-abandoning scan --------------------------
+  //
+  // Both distances must be *equal*, regardless of whether the shapelet
+  // occurs in the time series or not.
+
+  {
+    std::mt19937 rng( 42 );
+    std::normal_distribution<double> normal;
+
+    MASSDistance mass;
+
+    for( std::size_t m : { 1, 7, 64, 100, 1000, 5000 } )
+    {
+      std::vector<double> values( m );
+
+      // Random walk with an offset, which makes the sums of squares
+      // large in comparison to the distances.
+      double x = 100.0;
+      for( auto&& value : values )
+        value = ( x += normal( rng ) );
+
+      TimeSeries T( values.begin(), values.end() );
+
+      for( std::size_t n : { 1, 3, 10, 50, 300 } )
+      {
+        if( n > m )
+          continue;
+
+        for( std::size_t start : { std::size_t( 0 ), ( m - n ) / 2, m - n } )
+        {
+          std::vector<double> shapelet( values.begin() + long( start ), values.begin() + long( start + n ) );
+
+          TimeSeries S1( shapelet.begin(), shapelet.end() );
+
+          for( auto&& value : shapelet )
+            value += 0.1 * normal( rng );
+
+          TimeSeries S2( shapelet.begin(), shapelet.end() );
+
+          assert( mass( S1, T ) == 0.0 );
+          assert( mass( S1, T ) == S1.distance( T ) );
+          assert( mass( S2, T ) == S2.distance( T ) );
+          assert( mass( T, S2 ) == T.distance( S2 ) );
+        }
+      }
+    }
+
+    // Missing values only exclude the windows that contain them
+    {
+      std::vector<double> values( 2000 );
+
+      double x = 0.0;
+      for( auto&& value : values )
+        value = ( x += normal( rng ) );
+
+      values[ 10 ]   = std::numeric_limits<double>::quiet_NaN();
+      values[ 1500 ] = std::numeric_limits<double>::quiet_NaN();
+
+      TimeSeries T( values.begin(), values.end() );
+      TimeSeries S( values.begin() + 700, values.begin() + 950 );
+      TimeSeries U( values.begin() + 1400, values.begin() + 1650 );
+
+      for( auto&& value : values )
+        value += 0.1 * normal( rng );
+
+      TimeSeries V( values.begin() + 1000, values.begin() + 1250 );
+
+      assert( MASSDistance::cheaper( S.length(), T.length() ) );
+
+      assert( mass( S, T ) == 0.0 );
+      assert( mass( S, T ) == S.distance( T ) );
+      assert( mass( V, T ) == V.distance( T ) );
+      assert( mass( V, T ) <  std::numeric_limits<double>::max() );
+
+      // Every window contains the missing value of the shapelet
+      assert( mass( U, T ) == U.distance( T ) );
+    }
+
+    // Constant time series have many equal distances
+    {
+      TimeSeries S = { 1.0, 1.0, 1.0 };
+      TimeSeries T = { 2.0, 2.0, 2.0, 2.0, 2.0, 2.0 };
+
+      assert( mass( S, T ) == 3.0 );
+      assert( mass( S, T ) == S.distance( T ) );
+    }
+  }
+
+  // Vectorized kernels vs. scalar kernel --------------------------------
+  //
+  // All kernels that are supported by the CPU must yield exactly the same
+  // results; the lengths cover the remaining offsets of every kernel.
+
+  {
+    std::mt19937 rng( 23 );
+    std::normal_distribution<double> normal;
+
+    auto supported = detectInstructionSet();
+
+    for( std::size_t m : { 1, 2, 5, 9, 17, 64, 257, 1000 } )
+    {
+      std::vector<double> sequence( m );
+      for( auto&& value : sequence )
+        value = normal( rng );
+
+      for( std::size_t n : { 1, 2, 3, 7, 8, 9, 16, 33 } )
+      {
+        if( n > m )
+          continue;
+
+        std::vector<double> pattern( n );
+        for( auto&& value : pattern )
+          value = normal( rng );
+
+        auto expected = squaredEuclideanDistance( pattern.data(), n, sequence.data(), m, InstructionSet::Scalar );
+
+        for( auto instructionSet : { InstructionSet::SSE2, InstructionSet::AVX2, InstructionSet::AVX512 } )
+        {
+          if( instructionSet > supported )
+            continue;
+
+          assert( squaredEuclideanDistance( pattern.data(), n, sequence.data(), m, instructionSet ) == expected );
+
+          // Exact occurrences must be found as well
+          assert( squaredEuclideanDistance( sequence.data() + m - n, n, sequence.data(), m, instructionSet ) == 0.0 );
+        }
+
+        (void) expected;
+
+        for( unsigned p = 0; p <= maxIntegerPower; p++ )
+        {
+          auto expected = minkowskiDistance( pattern.data(), n, sequence.data(), m, p, InstructionSet::Scalar );
+
+          // Reference with the same order of operations
+          auto reference = std::numeric_limits<double>::max();
+
+          for( std::size_t i = 0; i + n <= m; i++ )
+          {
+            double temp = 0.0;
+            for( std::size_t j = 0; j < n; j++ )
+            {
+              auto d = std::abs( sequence[i+j] - pattern[j] );
+              auto r = p == 0 ? d : 1.0;
+
+              for( unsigned k = 0; k < p; k++ )
+                r = k == 0 ? d : r * d;
+
+              temp = p == 0 ? std::max( temp, r ) : temp + r;
+            }
+
+            reference = std::min( reference, temp );
+          }
+
+          assert( expected == reference );
+
+          for( auto instructionSet : { InstructionSet::SSE2, InstructionSet::AVX2, InstructionSet::AVX512 } )
+          {
+            if( instructionSet <= supported )
+              assert( minkowskiDistance( pattern.data(), n, sequence.data(), m, p, instructionSet ) == expected );
+          }
+
+          (void) expected;
+        }
+      }
+    }
+  }
+
+  // Compact storage vs. double precision -----------------------------
+  //
+  // Integers are stored exactly in both formats, so their distances must
+  // be equal. Otherwise, the distances must be within the tolerance.
+
+  {
+    std::mt19937 rng( 7 );
+    std::normal_distribution<double> normal;
+
+    // 0: integers, 1: one decimal, 2: arbitrary values, 3: integers with
+    // missing values, 4: arbitrary values with missing values
+    for( int kind = 0; kind < 5; kind++ )
+    {
+      std::vector<TimeSeries> timeSeries;
+
+      for( std::size_t length : { 40, 5, 64, 100, 17 } )
+      {
+        std::vector<double> values( length );
+        for( auto&& value : values )
+        {
+          value = normal( rng );
+
+          if( kind == 0 || kind == 3 )
+            value = std::round( 50.0 * value );
+          else if( kind == 1 )
+            value = std::round( 100.0 * value ) / 10.0;
+        }
+
+        // Every window of the shortest time series contains a missing
+        // value, so it has no finite distance at all.
+        if( kind >= 3 )
+        {
+          for( std::size_t k = 0; k < length; k += 11 )
+            values[k] = std::numeric_limits<double>::quiet_NaN();
+
+          if( length == 5 )
+            values[2] = std::numeric_limits<double>::quiet_NaN();
+        }
+
+        timeSeries.emplace_back( values.begin(), values.end() );
+      }
+
+      for( auto precision : { Precision::Float, Precision::Int16 } )
+      {
+        CompactStorage storage( timeSeries, precision );
+
+        if( precision == Precision::Int16 && kind == 1 )
+          assert( std::abs( storage.scale() - 0.1 ) < 1e-12 );
+
+        for( std::size_t i = 0; i < timeSeries.size(); i++ )
+        {
+          for( std::size_t n : { 1, 3, 12, 33 } )
+          {
+            for( std::size_t start = 0; start + n <= timeSeries[i].length(); start += 7 )
+            {
+              TimeSeries candidate( timeSeries[i].begin() + long( start ), timeSeries[i].begin() + long( start + n ) );
+
+              CandidateView view;
+              view.index  = unsigned( i );
+              view.start  = unsigned( start );
+              view.length = unsigned( n );
+
+              std::vector<double> distances( timeSeries.size() );
+              storage.distances( view, distances.data() );
+
+              for( std::size_t j = 0; j < timeSeries.size(); j++ )
+              {
+                auto expected = candidate.distance( timeSeries[j] );
+
+                if( kind == 0 || kind == 3 || expected == std::numeric_limits<double>::max() )
+                  assert( distances[j] == expected );
+                else
+                  assert( std::abs( distances[j] - expected ) <= storage.tolerance( std::min( n, timeSeries[j].length() ) ) );
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Prefix families vs. individual prefixes ----------------------------
+
+  {
+    std::mt19937 rng( 7 );
+    std::normal_distribution<double> normal;
+
+    auto supported = detectInstructionSet();
+
+    for( std::size_t m : { 4, 13, 50, 301 } )
+    {
+      std::vector<double> sequence( m );
+      for( auto&& value : sequence )
+        value = normal( rng );
+
+      std::vector<double> pattern( m );
+      for( auto&& value : pattern )
+        value = normal( rng );
+
+      for( auto instructionSet : { InstructionSet::Scalar, InstructionSet::SSE2, InstructionSet::AVX2, InstructionSet::AVX512 } )
+      {
+        if( instructionSet > supported )
+          continue;
+
+        for( std::size_t minLength : { 1, 3, 4 } )
+        {
+          for( std::size_t maxLength : { 4, 11, 40 } )
+          {
+            if( minLength > maxLength || maxLength > m )
+              continue;
+
+            std::vector<double> distances( maxLength - minLength + 1 );
+
+            // Occurring at the very end of the sequence leaves only a few
+            // windows for the longer prefixes.
+            for( auto start : { pattern.data(), sequence.data() + m - maxLength } )
+            {
+              squaredEuclideanDistances( start, minLength, maxLength, sequence.data(), m, distances.data(), instructionSet );
+
+              for( std::size_t n = minLength; n <= maxLength; n++ )
+                assert( distances[n - minLength] == squaredEuclideanDistance( start, n, sequence.data(), m, InstructionSet::Scalar ) );
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Batched distances vs. individual distances -------------------------
+
+  {
+    std::mt19937 rng( 11 );
+    std::normal_distribution<double> normal;
+
+    std::vector<TimeSeries> timeSeries;
+
+    for( std::size_t m : { 5, 30, 30, 97, 200 } )
+    {
+      std::vector<double> values( m );
+
+      double x = 50.0;
+      for( auto&& value : values )
+        value = ( x += normal( rng ) );
+
+      timeSeries.emplace_back( values.begin(), values.end() );
+    }
+
+    // Missing values must not affect the other windows
+    {
+      std::vector<double> values( timeSeries.back().begin(), timeSeries.back().end() );
+      values[100] = std::numeric_limits<double>::quiet_NaN();
+
+      timeSeries.emplace_back( values.begin(), values.end() );
+    }
+
+    for( std::size_t n : { 1, 8, 12, 40 } )
+    {
+      std::vector<TimeSeries> candidates;
+
+      for( std::size_t start = 0; start + n <= 200; start += 7 )
+        candidates.emplace_back( timeSeries[4].begin() + long( start ), timeSeries[4].begin() + long( start + n ) );
+
+      std::vector<const TimeSeries*> batch;
+      for( auto&& candidate : candidates )
+        batch.push_back( &candidate );
+
+      std::vector<double> distances;
+      batchedDistances( batch, timeSeries, distances );
+
+      assert( distances.size() == candidates.size() * timeSeries.size() );
+
+      for( std::size_t i = 0; i < candidates.size(); i++ )
+        for( std::size_t j = 0; j < timeSeries.size(); j++ )
+          assert( distances[ i * timeSeries.size() + j ] == candidates[i].distance( timeSeries[j] ) );
+    }
+
+    // Consecutive windows, including some that contain a missing value
+    for( std::size_t parent : { 4, 5 } )
+    {
+      for( std::size_t n : { 1, 8, 40, 60 } )
+      {
+        std::size_t start         = 70;
+        std::size_t numCandidates = 25;
+
+        std::vector<double> distances;
+        slidingDistances( timeSeries[parent], start, n, numCandidates, timeSeries, distances );
+
+        assert( distances.size() == numCandidates * timeSeries.size() );
+
+        for( std::size_t i = 0; i < numCandidates; i++ )
+        {
+          TimeSeries candidate( timeSeries[parent].begin() + long( start + i ),
+                                timeSeries[parent].begin() + long( start + i + n ) );
+
+          for( std::size_t j = 0; j < timeSeries.size(); j++ )
+          {
+            auto expected = candidate.distance( timeSeries[j] );
+            auto actual   = distances[ i * timeSeries.size() + j ];
+
+            assert( actual == expected || ( std::isnan( actual ) && std::isnan( expected ) ) );
+
+            (void) expected;
+            (void) actual;
+          }
+        }
+      }
+    }
+  }
+
+  // Cascade of lower bounds vs. plain scan ----------------------------
+
+  {
+    std::mt19937 rng( 17 );
+    std::normal_distribution<double> normal;
+
+    // Reference implementation of all norms, i.e. the scan over all
+    // offsets with early abandoning in the natural order.
+    auto scan = [] ( const std::vector<double>& x, const std::vector<double>& y, double p )
+    {
+      auto distance = std::numeric_limits<double>::max();
+
+      for( std::size_t i = 0; i + x.size() <= y.size(); i++ )
+      {
+        double temp = 0.0;
+        for( std::size_t j = 0; j < x.size(); j++ )
+        {
+          auto d = std::abs( y[i+j] - x[j] );
+
+          if( p == 2 )
+            temp += d * d;
+          else if( p > 1 )
+            temp += std::pow( d, p );
+          else if( p > 0 )
+            temp += d;
+          else
+            temp = std::max( temp, d );
+
+          if( temp > distance )
+            break;
+        }
+
+        distance = std::min( distance, temp );
+      }
+
+      return distance;
+    };
+
+    std::vector< std::vector<double> > sequences;
+
+    for( std::size_t k = 0; k < 4; k++ )
+    {
+      std::vector<double> values( 300 );
+
+      double x = 0.0;
+      for( auto&& value : values )
+        value = k % 2 ? ( x += normal( rng ) ) : normal( rng );
+
+      sequences.push_back( values );
+    }
+
+    sequences.back()[150] = std::numeric_limits<double>::quiet_NaN();
+
+    for( std::size_t n : { 1, 2, 7, 33, 300 } )
+    {
+      std::vector<double> pattern( sequences[1].begin() + 200, sequences[1].begin() + 200 + long( std::min( n, std::size_t( 100 ) ) ) );
+      if( n == 300 )
+        pattern = sequences[0];
+
+      for( auto&& sequence : sequences )
+      {
+        assert( cascadeDistance( pattern.data(), pattern.size(), sequence.data(), sequence.size(), Norm::SquaredEuclidean ) == scan( pattern, sequence, 2.0 ) );
+        assert( cascadeDistance( pattern.data(), pattern.size(), sequence.data(), sequence.size(), Norm::Manhattan )        == scan( pattern, sequence, 1.0 ) );
+        assert( cascadeDistance( pattern.data(), pattern.size(), sequence.data(), sequence.size(), Norm::Power, 3.0 )      == scan( pattern, sequence, 3.0 ) );
+        assert( cascadeDistance( pattern.data(), pattern.size(), sequence.data(), sequence.size(), Norm::Power, 1.5 )      == scan( pattern, sequence, 1.5 ) );
+        assert( cascadeDistance( pattern.data(), pattern.size(), sequence.data(), sequence.size(), Norm::Chebyshev )        == scan( pattern, sequence, 0.0 ) );
+
+        (void) sequence;
+      }
+    }
+
+    (void) scan;
+
+    auto statistics = takeLowerBoundStatistics();
+
+    assert( statistics.numOffsets > 0 );
+    assert( statistics.numKim + statistics.numPAA + statistics.numAbandoned <= statistics.numOffsets );
+
+    // Taking the statistics resets them
+    assert( takeLowerBoundStatistics().numOffsets == 0 );
+
+    (void) statistics;
+  }
+
+  // Closed-form Lp distances vs. piecewise linear functions ----------
+
+  {
+    std::mt19937 rng( 19 );
+    std::normal_distribution<double> normal;
+
+    std::vector<double> sequence( 80 );
+    for( auto&& value : sequence )
+      value = normal( rng );
+
+    TimeSeries T( sequence.begin(), sequence.end() );
+
+    for( std::size_t n : { 1, 2, 5, 30 } )
+    {
+      std::vector<double> pattern( n );
+      for( auto&& value : pattern )
+        value = normal( rng );
+
+      TimeSeries S( pattern.begin(), pattern.end() );
+
+      // Powers with a fractional part are omitted because they are not
+      // defined for negative differences.
+      for( double p : { 0.0, 1.0, 2.0, 3.0 } )
+      {
+        auto f        = PiecewiseLinearFunction( pattern.begin(), pattern.end() );
+        auto expected = std::numeric_limits<double>::max();
+
+        for( std::size_t i = 0; i + n <= sequence.size(); i++ )
+        {
+          auto g   = PiecewiseLinearFunction( sequence.begin() + long( i ), sequence.begin() + long( i + n ) );
+          expected = std::min( expected, std::abs( ( f - g ).norm( p ) ) );
+        }
+
+        LpDistance distance( p );
+
+        assert( std::abs( distance( S, T ) - expected ) <= 1e-12 * ( 1.0 + expected ) );
+        assert( distance( T, S ) == distance( S, T ) );
+      }
+    }
+  }
+
+  // Dynamic time warping vs. full matrix ------------------------------
+
+  {
+    std::mt19937 rng( 29 );
+    std::normal_distribution<double> normal;
+
+    // Reference implementation that fills the whole matrix
+    auto dtw = [] ( const std::vector<double>& x, const double* y, std::size_t r )
+    {
+      auto n        = x.size();
+      auto infinity = std::numeric_limits<double>::infinity();
+
+      std::vector< std::vector<double> > D( n, std::vector<double>( n, infinity ) );
+
+      for( std::size_t i = 0; i < n; i++ )
+      {
+        for( std::size_t j = 0; j < n; j++ )
+        {
+          if( ( i > j ? i - j : j - i ) > r )
+            continue;
+
+          auto cost = ( x[i] - y[j] ) * ( x[i] - y[j] );
+
+          if( i == 0 && j == 0 )
+            D[i][j] = cost;
+          else
+          {
+            auto best = infinity;
+            if( i > 0 )
+              best = std::min( best, D[i-1][j] );
+            if( j > 0 )
+              best = std::min( best, D[i][j-1] );
+            if( i > 0 && j > 0 )
+              best = std::min( best, D[i-1][j-1] );
+
+            D[i][j] = best + cost;
+          }
+        }
+      }
+
+      return D[n-1][n-1];
+    };
+
+    std::vector<double> values( 120 );
+
+    double x = 0.0;
+    for( auto&& value : values )
+      value = ( x += normal( rng ) );
+
+    TimeSeries T( values.begin(), values.end() );
+
+    for( std::size_t n : { 1, 2, 9, 25 } )
+    {
+      std::vector<double> pattern( n );
+
+      // A shapelet that is a time-shifted copy of a part of the series
+      for( std::size_t j = 0; j < n; j++ )
+        pattern[j] = values[ 40 + j + ( j % 3 == 1 ? 1 : 0 ) ] + 0.1 * normal( rng );
+
+      TimeSeries S( pattern.begin(), pattern.end() );
+
+      for( double band : { 0.0, 1.0, 3.0, 0.2, 1000.0 } )
+      {
+        auto r = std::min( n - 1, std::size_t( band < 1 ? std::floor( band * double( n ) ) : band ) );
+
+        auto expected = std::numeric_limits<double>::max();
+        for( std::size_t i = 0; i + n <= values.size(); i++ )
+          expected = std::min( expected, dtw( pattern, values.data() + i, r ) );
+
+        DTWDistance distance( band );
+
+        assert( distance( S, T ) == expected );
+        assert( distance( T, S ) == expected );
+
+        // Without warping, this is the squared Euclidean distance
+        if( r == 0 )
+          assert( distance( S, T ) == S.distance( T ) );
+        else
+          assert( distance( S, T ) <= S.distance( T ) );
+      }
+    }
+  }
+
+  // Batch entry point vs. individual distances -----------------------
+  //
+  // Both the built-in functors and the default adapter for custom ones
+  // must yield the same distances as the main entry point.
+
+  {
+    // Reverses the argument order, so it does not inherit from the
+    // built-in functors' batch implementation.
+    struct ReversedDistance : public DistanceFunctor
+    {
+      virtual ValueType operator()( const TimeSeries& S, const TimeSeries& T ) const
+      {
+        return T.distance( S );
+      }
+
+      virtual std::string name() const
+      {
+        return "reversed";
+      }
+    };
+
+    std::mt19937 rng( 42 );
+    std::normal_distribution<double> normal;
+
+    std::vector<TimeSeries> timeSeries;
+
+    for( std::size_t length : { 3, 40, 17, 64, 8 } )
+    {
+      std::vector<double> values( length );
+      for( auto&& value : values )
+        value = normal( rng );
+
+      timeSeries.emplace_back( values.begin(), values.end() );
+    }
+
+    std::vector<double> values( 12 );
+    for( auto&& value : values )
+      value = normal( rng );
+
+    TimeSeries candidate( values.begin(), values.end() );
+
+    DTWDistance dtw( 0.25 );
+    LpDistance lp( 2.0 );
+    MASSDistance mass;
+    ReversedDistance reversed;
+    ZNormalizedDistance znorm;
+
+    for( const DistanceFunctor* functor : std::vector<const DistanceFunctor*>{ &dtw, &lp, &mass, &reversed, &znorm } )
+    {
+      std::vector<double> distances( timeSeries.size() );
+      functor->distances( candidate, timeSeries, distances.data() );
+
+      for( std::size_t j = 0; j < timeSeries.size(); j++ )
+        assert( distances[j] == ( *functor )( candidate, timeSeries[j] ) );
+    }
+  }
+
+  // Z-normalized distances --------------------------------------------
+
+  {
+    std::mt19937 rng( 13 );
+    std::normal_distribution<double> normal;
+
+    ZNormalizedDistance distance;
+
+    std::vector<double> values( 150 );
+
+    double x = 0.0;
+    for( auto&& value : values )
+      value = ( x += normal( rng ) );
+
+    TimeSeries T( values.begin(), values.end() );
+
+    // Scaled and shifted occurrences are found at the same distance
+    for( std::size_t start : { 0, 17, 110 } )
+    {
+      std::vector<double> window( values.begin() + long( start ), values.begin() + long( start + 40 ) );
+      for( auto&& value : window )
+        value = 1000.0 + 3.0 * value;
+
+      TimeSeries S( window.begin(), window.end() );
+      assert( distance( S, T ) < 1e-9 );
+      assert( distance( T, S ) == distance( S, T ) );
+    }
+
+    // Naive calculation with two passes per window
+    for( std::size_t n : { 2, 10, 40 } )
+    {
+      std::vector<double> pattern( n );
+      for( auto&& value : pattern )
+        value = normal( rng );
+
+      TimeSeries S( pattern.begin(), pattern.end() );
+
+      auto normalize = [] ( std::vector<double> v )
+      {
+        double mean = 0.0;
+        for( auto&& value : v )
+          mean += value;
+        mean /= double( v.size() );
+
+        double variance = 0.0;
+        for( auto&& value : v )
+          variance += ( value - mean ) * ( value - mean );
+        variance /= double( v.size() );
+
+        for( auto&& value : v )
+          value = ( value - mean ) / std::sqrt( variance );
+
+        return v;
+      };
+
+      auto p        = normalize( pattern );
+      auto expected = std::numeric_limits<double>::max();
+
+      for( std::size_t i = 0; i + n <= values.size(); i++ )
+      {
+        auto w = normalize( std::vector<double>( values.begin() + long( i ), values.begin() + long( i + n ) ) );
+
+        double d = 0.0;
+        for( std::size_t j = 0; j < n; j++ )
+          d += ( p[j] - w[j] ) * ( p[j] - w[j] );
+
+        expected = std::min( expected, d );
+      }
+
+      assert( std::abs( distance( S, T ) - expected ) < 1e-9 * ( 1.0 + expected ) );
+    }
+
+    // Constant windows are normalized to zero
+    {
+      std::vector<double> constant( 20, 5.0 );
+      std::vector<double> other( 50, -3.0 );
+
+      TimeSeries S( constant.begin(), constant.end() );
+      TimeSeries U( other.begin(), other.end() );
+
+      assert( distance( S, U ) == 0.0 );
+      assert( std::abs( distance( S, T ) - 20.0 ) < 1e-9 );
+    }
+  }
+
+  assert(  MASSDistance::cheaper( 1000, 100000 ) );
+  assert( !MASSDistance::cheaper(   10,     50 ) );
+  assert( !MASSDistance::cheaper(   50,     10 ) );
+}
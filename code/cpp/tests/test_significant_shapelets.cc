@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <cassert>
+
+#include "SignificantShapelets.hh"
+#include "TimeSeries.hh"
+
+namespace
+{
+
+/**
+  Creates a set of random walks with alternating labels, which contains
+  many candidates whose tables are testable for the largest thresholds,
+  but no significant ones.
+*/
+
+std::vector<TimeSeries> randomWalks( unsigned n, unsigned length, std::vector<bool>& labels )
+{
+  std::mt19937 rng( 42 );
+  std::normal_distribution<double> steps;
+
+  std::vector<TimeSeries> timeSeries;
+  labels.clear();
+
+  for( unsigned i = 0; i < n; i++ )
+  {
+    std::vector<double> values( length );
+
+    double value = 0.0;
+    for( auto&& x : values )
+      x = value += steps( rng );
+
+    timeSeries.emplace_back( values.begin(), values.end() );
+    labels.push_back( i % 2 == 0 );
+  }
+
+  return timeSeries;
+}
+
+/**
+  Adds a bump to the time series of class 1, so that the shapelets that
+  contain it are significant.
+*/
+
+void addBumps( std::vector<TimeSeries>& timeSeries, const std::vector<bool>& labels, unsigned start, unsigned length )
+{
+  for( std::size_t i = 0; i < timeSeries.size(); i++ )
+  {
+    if( !labels[i] )
+      continue;
+
+    std::vector<double> values( timeSeries[i].begin(), timeSeries[i].end() );
+    for( unsigned j = start; j < start + length; j++ )
+      values[j] += 25.0;
+
+    timeSeries[i] = TimeSeries( values.begin(), values.end() );
+  }
+}
+
+} // end of anonymous namespace
+
+int main( int, char** )
+{
+  // Exhausted thresholds ----------------------------------------------
+  //
+  // For a small cohort, the random walks yield enough testable tables
+  // to use up every level of Tarone's threshold. Afterwards, no pattern
+  // is testable and nothing is reported.
+
+  {
+    std::vector<bool> labels;
+    auto timeSeries = randomWalks( 8, 60, labels );
+
+    for( bool disablePruning : { false, true } )
+    {
+      for( unsigned numThreads : { 1u, 4u } )
+      {
+        SignificantShapelets S( 5, 10, 1 );
+
+        S.quiet();
+        S.disablePruning( disablePruning );
+        S.setNumThreads( numThreads );
+
+        long double tarone = 1.0;
+        std::vector<long double> thresholds;
+
+        auto shapelets = S( timeSeries, labels, tarone, thresholds );
+
+        assert( shapelets.empty() );
+        assert( tarone == 0.0 );
+        assert( thresholds.size() >= 2 );
+        assert( thresholds.back() == 0.0 );
+
+        // The thresholds decrease strictly until the last one
+        assert( std::adjacent_find( thresholds.begin(), thresholds.end(), std::less_equal<long double>() ) == thresholds.end() );
+      }
+    }
+  }
+
+  // Pruning -----------------------------------------------------------
+  //
+  // Pruning only removes tables that can never become testable, so the
+  // extraction yields the same shapelets, $p$-values, and thresholds as
+  // without pruning.
+
+  {
+    std::vector<bool> labels;
+    auto timeSeries = randomWalks( 40, 40, labels );
+
+    addBumps( timeSeries, labels, 20, 10 );
+
+    long double tarone[2];
+    std::vector<long double> thresholds[2];
+    std::vector<SignificantShapelets::SignificantShapelet> shapelets[2];
+
+    for( bool disablePruning : { false, true } )
+    {
+      SignificantShapelets S( 8, 12, 1 );
+
+      S.quiet();
+      S.disablePruning( disablePruning );
+
+      shapelets[disablePruning] = S( timeSeries, labels, tarone[disablePruning], thresholds[disablePruning] );
+    }
+
+    assert( !shapelets[0].empty() );
+    assert( tarone[0] == tarone[1] );
+    assert( thresholds[0] == thresholds[1] );
+    assert( shapelets[0].size() == shapelets[1].size() );
+
+    for( std::size_t i = 0; i < shapelets[0].size(); i++ )
+    {
+      auto&& s = shapelets[0][i];
+      auto&& t = shapelets[1][i];
+
+      assert( s.index == t.index && s.start == t.start && s.length == t.length );
+      assert( s.p == t.p );
+      assert( s.table == t.table );
+
+      (void) s;
+      (void) t;
+    }
+  }
+
+  // No thresholds at all ----------------------------------------------
+  //
+  // With two time series per class, no table is able to reach a $p$-value
+  // below alpha, so no level is left to begin with.
+
+  {
+    std::vector<bool> labels;
+    auto timeSeries = randomWalks( 4, 30, labels );
+
+    SignificantShapelets S( 5, 1 );
+    S.quiet();
+
+    long double tarone = 1.0;
+    std::vector<long double> thresholds;
+
+    auto shapelets = S( timeSeries, labels, tarone, thresholds );
+
+    assert( shapelets.empty() );
+    assert( tarone == 0.0 );
+    assert( thresholds.size() == 1 );
+    assert( thresholds.front() == 0.0 );
+  }
+}
@@ -1,8 +1,16 @@
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
 
 #include <cassert>
+#include <cstdint>
 
+#include "Dataset.hh"
 #include "Environment.hh"
+#include "SlidingWindow.hh"
 #include "TimeSeries.hh"
 #include "Utilities.hh"
 
@@ -38,6 +46,9 @@ int main( int, char** )
     assert( labels[1] == true );
     assert( labels[2] == false );
     assert( labels[3] == true );
+
+    (void) timeSeries;
+    (void) labels;
   }
 
   // Skipping some columns ---------------------------------------------
@@ -61,5 +72,151 @@ int main( int, char** )
     assert( timeSeries[2][5] == 15 );
     assert( timeSeries[2][6] == 19 );
     assert( timeSeries[2][7] == 21 );
+
+    (void) timeSeries;
+  }
+
+  // Duplicate removal vs. brute force ----------------------------------
+
+  {
+    // Few distinct values, some of which are close to each other, and
+    // missing values lead to many duplicates of either kind.
+    std::vector<double> values = { 0.0, -0.0, 1.0, 1.0 + 1e-7, 1.5, 2.0, std::numeric_limits<double>::quiet_NaN() };
+
+    std::mt19937 rng( 42 );
+    std::uniform_int_distribution<std::size_t> value( 0, values.size() - 1 );
+    std::uniform_int_distribution<std::size_t> length( 1, 12 );
+
+    std::vector<TimeSeries> timeSeries;
+
+    for( unsigned i = 0; i < 20; i++ )
+    {
+      std::vector<double> data( length( rng ) );
+      for( auto&& x : data )
+        x = values[ value( rng ) ];
+
+      timeSeries.emplace_back( data.begin(), data.end() );
+    }
+
+    // Default tolerances, no tolerances at all, and large tolerances
+    for( auto&& tolerances : { std::make_pair( 1e-6, 1e-8 ), std::make_pair( 0.0, 0.0 ), std::make_pair( 0.1, 0.5 ) } )
+    {
+      auto rtol = tolerances.first;
+      auto atol = tolerances.second;
+
+      SlidingWindow sw( 1, 4, 1 );
+      sw.setRemoveDuplicates();
+      sw.setTolerances( rtol, atol );
+
+      auto candidates = sw( timeSeries );
+
+      // Reference implementation with a linear scan over all candidates
+      auto window = [&timeSeries] ( const CandidateView& view )
+      {
+        auto begin = timeSeries[ view.index ].begin() + long( view.start );
+        return TimeSeries( begin, begin + long( view.length ) );
+      };
+
+      std::vector<CandidateView> expected;
+
+      for( unsigned i = 0; i < timeSeries.size(); i++ )
+      {
+        std::vector<CandidateView> local;
+
+        for( unsigned n = 1; n <= 4; n++ )
+        {
+          for( unsigned start = 0; start + n <= timeSeries[i].length(); start++ )
+          {
+            CandidateView view;
+            view.index  = i;
+            view.start  = start;
+            view.length = n;
+
+            bool unique = true;
+            for( auto&& other : local )
+              unique = unique && !window( other ).isClose( window( view ), rtol, atol );
+
+            if( unique )
+              local.push_back( view );
+          }
+        }
+
+        for( auto&& view : local )
+        {
+          bool unique = true;
+          for( auto&& other : expected )
+            unique = unique && !window( other ).isClose( window( view ), rtol, atol );
+
+          if( unique )
+            expected.push_back( view );
+        }
+      }
+
+      assert( candidates.size() == expected.size() );
+
+      for( std::size_t k = 0; k < expected.size(); k++ )
+      {
+        assert( candidates[k].index  == expected[k].index  );
+        assert( candidates[k].start  == expected[k].start  );
+        assert( candidates[k].length == expected[k].length );
+      }
+    }
+  }
+
+  // Dataset -------------------------------------------------------------
+
+  {
+    auto data         = readData( CMAKE_SOURCE_DIR + std::string("/tests/data/short.csv") );
+    auto&& timeSeries = data.first;
+
+    Dataset dataset( timeSeries );
+
+    assert( dataset.size() == timeSeries.size() );
+
+    for( std::size_t i = 0; i < dataset.size(); i++ )
+    {
+      auto&& T = dataset[i];
+
+      assert( T.isView() );
+      assert( T == timeSeries[i] );
+      assert( reinterpret_cast<std::uintptr_t>( T.data() ) % Dataset::alignment == 0 );
+
+      // The cumulative sums have to match the ones of the kernels exactly
+      double sum = 0.0;
+
+      for( std::size_t k = 0; k < T.length(); k++ )
+      {
+        assert( T.squaredSums()[k] == sum );
+        sum += T[k] * T[k];
+      }
+
+      assert( T.squaredSums()[ T.length() ] == sum );
+    }
+
+    // Without squared sums, the values are the same, but the buffer is
+    // smaller
+    Dataset values( timeSeries, false, false );
+
+    assert( values.bytes() < dataset.bytes() );
+
+    for( std::size_t i = 0; i < values.size(); i++ )
+    {
+      assert( values[i] == timeSeries[i] );
+      assert( values[i].squaredSums() == nullptr );
+      assert( reinterpret_cast<std::uintptr_t>( values[i].data() ) % Dataset::alignment == 0 );
+    }
+
+    // Copies of a view refer to the same values until they are changed
+    auto T = dataset[2];
+
+    assert( T.isView() );
+    assert( T.data() == dataset[2].data() );
+
+    T.pop_back();
+
+    assert( !T.isView() );
+    assert( T.length() + 1 == dataset[2].length() );
+    assert( T.squaredSums() == nullptr );
+    assert( std::equal( T.begin(), T.end(), dataset[2].begin() ) );
   }
 }